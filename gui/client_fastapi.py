@@ -30,6 +30,9 @@ logging.basicConfig(
 )
 logger = logging.getLogger(__name__)
 
+# Журнал C++ ядра пишется в тот же файл
+multicast_core.use_python_logging("multicast_core")
+
 
 # Wrapper С++ библиотеки
 class StreamManager:
@@ -37,6 +40,8 @@ class StreamManager:
         self.client = multicast_core.Receiver(MCAST_GRP, MCAST_PORT)
         self.is_streaming = False
         self.last_preview = None
+        # Sender шлёт тайлы или полосы: цельных JPEG'ов не будет
+        self.segmented_stream = False
 
     def start_streaming(self):
         """Start streaming if not already started."""
@@ -53,6 +58,7 @@ class StreamManager:
             self.client.stop()
             self.is_streaming = False
             self.last_preview = None
+            self.segmented_stream = False
             logger.info("Streaming stopped")
 
     def get_latest_frame(self):
@@ -64,6 +70,45 @@ class StreamManager:
                 return frame
         return None
 
+    def wait_for_jpeg(self, last_sequence, timeout_ms=1000):
+        """Wait for a frame newer than last_sequence, return (jpeg, seq) or None."""
+        if not self.is_streaming:
+            return None
+
+        # Сегментированные кадры (тайлы, полосы) JPEG'ом не публикуются: ждём
+        # декодированный кадр и кодируем его заново
+        if self.segmented_stream:
+            result = self.client.wait_for_frame(last_sequence, timeout_ms)
+            if result is None:
+                self.segmented_stream = False
+                return None
+            frame, sequence, _ = result
+            self.last_preview = frame
+            encoded = self.client.get_latest_encoded_frame()
+            if encoded is not None and encoded[1] >= sequence:
+                self.segmented_stream = False
+                jpeg, sequence, _ = encoded
+                return jpeg.tobytes(), sequence
+            _, jpeg = cv2.imencode(".jpg", frame)
+            return jpeg.tobytes(), sequence
+
+        # Цельный кадр отдаём тем же JPEG, что прислал Sender, без перекодирования.
+        # Ожидание не зависит от декодирования (set_decode_enabled(False))
+        encoded = self.client.wait_for_encoded_frame(last_sequence, timeout_ms)
+        if encoded is not None:
+            jpeg, sequence, _ = encoded
+            return jpeg.tobytes(), sequence
+
+        # Цельных кадров нет, а декодированные есть - поток сегментированный
+        result = self.client.wait_for_frame(last_sequence, 0)
+        if result is None:
+            return None
+        self.segmented_stream = True
+        frame, sequence, _ = result
+        self.last_preview = frame
+        _, jpeg = cv2.imencode(".jpg", frame)
+        return jpeg.tobytes(), sequence
+
     def get_status(self):
         """Get the current status of the streaming."""
         return "streaming" if self.is_streaming else "stopped"
@@ -100,8 +145,26 @@ class WebServer:
             {
                 "total_packets": stats.totalPacketsReceived,
                 "lost_packets": stats.totalCorruptedPackets,
-                "complete_frames": stats.totalFramesDecoded,
+                "complete_frames": (
+                    stats.totalFramesDecoded + stats.totalFramesPassedThrough
+                ),
                 "average_fps": round(stats.avgFps, 2),
+                "window_fps": round(stats.windowFps, 2),
+                "jitter_ms": round(stats.jitterMs, 2),
+                "latency_ms": {
+                    name: {
+                        "p50": round(summary.p50Ms, 3),
+                        "p99": round(summary.p99Ms, 3),
+                        "p999": round(summary.p999Ms, 3),
+                    }
+                    for name, summary in (
+                        ("capture_to_encode", stats.captureToEncodeLatency),
+                        ("capture_to_send", stats.captureToSendLatency),
+                        ("reassembly", stats.reassemblyLatency),
+                        ("decode", stats.decodeLatency),
+                        ("pickup", stats.pickupLatency),
+                    )
+                },
                 "packet_loss": round(
                     (stats.totalCorruptedPackets / stats.totalPacketsReceived * 100)
                     if stats.totalPacketsReceived > 0
@@ -136,23 +199,26 @@ class WebServer:
 
     def generate_frames(self):
         """Generate video frames for streaming."""
+        last_sequence = 0
         while True:
             try:
-                frame = self.controller.get_latest_frame()
+                # Ждём следующий кадр без опроса: каждый кадр отдаётся один раз
+                result = self.controller.wait_for_jpeg(last_sequence)
 
                 # Если долго нет нового кадра — показываем заглушку
-                if frame is None or not self.controller.check_server_activity():
+                if result is None or not self.controller.check_server_activity():
                     logger.warning("No frame received recently, showing placeholder.")
                     placeholder = self.get_placeholder_image()
                     _, jpeg = cv2.imencode(".jpg", placeholder)
+                    jpeg = jpeg.tobytes()
+                    time.sleep(1 / 30)
                 else:
-                    _, jpeg = cv2.imencode(".jpg", frame)
+                    jpeg, last_sequence = result
 
                 yield (
                     b"--frame\r\n"
-                    b"Content-Type: image/jpeg\r\n\r\n" + jpeg.tobytes() + b"\r\n"
+                    b"Content-Type: image/jpeg\r\n\r\n" + jpeg + b"\r\n"
                 )
-                time.sleep(1 / 30)
             except Exception as e:
                 logger.error(f"Preview generation error: {str(e)}")
                 break
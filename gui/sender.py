@@ -1,3 +1,4 @@
+import sys
 import time
 
 import cv2
@@ -9,7 +10,14 @@ MCAST_PORT = 5000
 
 
 def main():
-    sender = multicast_core.Sender(MCAST_GRP, MCAST_PORT)
+    # Без камеры: sender.py synthetic или sender.py <видеофайл>
+    config = multicast_core.SenderConfig()
+    if len(sys.argv) > 1 and sys.argv[1] == "synthetic":
+        config.source.type = multicast_core.FrameSourceType.Synthetic
+    elif len(sys.argv) > 1:
+        config.source.type = multicast_core.FrameSourceType.VideoFile
+        config.source.path = sys.argv[1]
+    sender = multicast_core.Sender(MCAST_GRP, MCAST_PORT, config)
 
     if not sender.start_stream():
         print("Failed to start stream")
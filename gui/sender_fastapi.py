@@ -30,6 +30,9 @@ logging.basicConfig(
 )
 logger = logging.getLogger(__name__)
 
+# Журнал C++ ядра пишется в тот же файл
+multicast_core.use_python_logging("multicast_core")
+
 
 # Wrapper С++ библиотеки
 class StreamManager:
@@ -85,10 +88,33 @@ class WebServer:
         self.app.mount("/styles", StaticFiles(directory="styles"), name="styles")
 
     def get_stats(self):
-        active_clients_count = self.controller.sender.get_active_client_count()
+        stats = self.controller.sender.get_statistics()
         return JSONResponse(
             {
-                "viewers": active_clients_count,
+                "viewers": stats.activeClients,
+                "fps": round(stats.windowFps, 2),
+                "bitrate_kbps": round(stats.bitrateKbps, 1),
+                "frames_captured": stats.totalFramesCaptured,
+                "frames_sent": stats.totalFramesSent,
+                "frames_dropped": stats.totalFramesDropped,
+                "capture_stalls": stats.totalCaptureStalls,
+                "avg_frame_size": round(stats.avgFrameSize),
+                "packets_per_frame": round(stats.avgPacketsPerFrame, 1),
+                "send_errors": stats.totalSendErrors,
+                "send_would_block": stats.totalSendWouldBlock,
+                "latency_ms": {
+                    name: {
+                        "p50": round(summary.p50Ms, 3),
+                        "p99": round(summary.p99Ms, 3),
+                        "p999": round(summary.p999Ms, 3),
+                    }
+                    for name, summary in (
+                        ("capture", stats.captureLatency),
+                        ("encode", stats.encodeLatency),
+                        ("transmit", stats.transmitLatency),
+                        ("capture_to_send", stats.captureToSendLatency),
+                    )
+                },
             }
         )
 
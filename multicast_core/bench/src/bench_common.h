@@ -0,0 +1,41 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <chrono>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+namespace bench {
+
+// Синтетический кадр, похожий на камеру: градиент, фигуры и шум
+inline cv::Mat makeFrame(int width, int height, int index) {
+    cv::Mat frame(height, width, CV_8UC3);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < width; ++x) {
+            row[3 * x] = static_cast<uint8_t>(x * 255 / width);
+            row[3 * x + 1] = static_cast<uint8_t>(y * 255 / height);
+            row[3 * x + 2] = static_cast<uint8_t>((x + y + index) & 0xff);
+        }
+    }
+    cv::rectangle(frame, cv::Rect((index * 7) % (width / 2), height / 4, width / 4, height / 3),
+                  cv::Scalar(30, 200, 90), -1);
+    cv::Mat noise(height, width, CV_8UC3);
+    cv::randu(noise, cv::Scalar(0, 0, 0), cv::Scalar(16, 16, 16));
+    frame += noise;
+    return frame;
+}
+
+// Среднее время одной итерации body в миллисекундах, после короткого прогрева
+template <typename Body>
+double measure(int iterations, Body&& body) {
+    for (int i = 0; i < 5; ++i) body(i);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) body(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count() / iterations;
+}
+
+}  // namespace bench
+
+#endif  // BENCH_COMMON_H
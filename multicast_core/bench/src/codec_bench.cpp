@@ -0,0 +1,72 @@
+// Сравнение JpegEncoder/JpegDecoder с прежним путём через cv::imencode/cv::imdecode.
+// Запуск: codec_bench [ширина высота кадров], по умолчанию 1920 1080 200
+#include <jpeg_codec.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "bench_common.h"
+
+using namespace MulticastLib;
+using bench::makeFrame;
+using bench::measure;
+
+namespace {
+
+void report(const char* name, double ms, double baselineMs) {
+    printf("%-32s %8.3f ms %8.1f fps %6.2fx\n", name, ms, 1000.0 / ms, baselineMs / ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 2 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int iterations = argc > 3 ? atoi(argv[3]) : 200;
+    const int quality = 80;
+
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < 8; ++i) frames.push_back(makeFrame(width, height, i));
+    printf("%dx%d, %d iterations, libjpeg-turbo: %s\n", width, height, iterations,
+           jpegCodecAccelerated() ? "yes" : "no");
+
+    // Кодирование: прежний путь создаёт буфер и параметры на каждый кадр
+    double opencvEncode = measure(iterations, [&](int i) {
+        std::vector<uchar> buffer;
+        std::vector<int> params{cv::IMWRITE_JPEG_QUALITY, quality};
+        cv::imencode(".jpg", frames[i % frames.size()], buffer, params);
+    });
+    JpegEncoder encoder;
+    std::vector<uchar> encoded;
+    double codecEncode = measure(
+        iterations, [&](int i) { encoder.encode(frames[i % frames.size()], quality, encoded); });
+
+    std::vector<std::vector<uchar>> jpegs(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) encoder.encode(frames[i], quality, jpegs[i]);
+
+    // Декодирование: прежний путь - новый Mat из imdecode и его clone() при выдаче
+    cv::Mat published;
+    double opencvDecode = measure(iterations, [&](int i) {
+        cv::Mat decoded = cv::imdecode(jpegs[i % jpegs.size()], cv::IMREAD_COLOR);
+        published = decoded.clone();
+    });
+    JpegDecoder decoder;
+    cv::Mat frame;
+    double codecDecode = measure(iterations, [&](int i) {
+        const auto& jpeg = jpegs[i % jpegs.size()];
+        decoder.decode(jpeg.data(), jpeg.size(), frame);
+    });
+    double codecDecodeYuv = measure(iterations, [&](int i) {
+        const auto& jpeg = jpegs[i % jpegs.size()];
+        decoder.decodeYuv(jpeg.data(), jpeg.size(), frame);
+    });
+
+    report("encode: cv::imencode", opencvEncode, opencvEncode);
+    report("encode: JpegEncoder", codecEncode, opencvEncode);
+    report("decode: cv::imdecode + clone", opencvDecode, opencvDecode);
+    report("decode: JpegDecoder BGR", codecDecode, opencvDecode);
+    report("decode: JpegDecoder I420", codecDecodeYuv, opencvDecode);
+    return 0;
+}
@@ -0,0 +1,470 @@
+// Набор бенчмарков ядра с JSON-отчётом для сравнения сборок между собой: кодек,
+// нарезка кадра на чанки (Sender::sendFrameToMulticast), сборка кадра из пакетов
+// (Receiver::processPacket) по разрешениям и MTU, и сквозной прогон Sender -> несколько
+// Receiver'ов через LoopbackNetwork, а также Sender -> Receiver через настоящий UDP
+// multicast с сокетами и с io_uring, с GSO/GRO и без.
+// Запуск: multicast_core_bench [--json файл|-] [--iterations N] [--only имя]
+//         [--receivers N] [--seconds S] [--fps F] [--resolution ШxВ]
+// --only оставляет одну группу: codec, packetize, reassemble, loopback или udp
+#include <arpa/inet.h>
+#include <jpeg_codec.h>
+#include <latency_histogram.h>
+#include <logging.h>
+#include <loopback_transport.h>
+#include <protocol.h>
+#include <receiver.h>
+#include <sender.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench_common.h"
+
+namespace MulticastLib {
+
+// Стадии Sender'а и Receiver'а в обход их потоков (friend обоих классов)
+struct BenchAccess {
+    static void packetize(Sender& sender, const std::vector<uchar>& jpeg, uint32_t frameSeq) {
+        Sender::FrameMeta frame;
+        frame.frameSeq = frameSeq;
+        frame.frameSize = static_cast<uint32_t>(jpeg.size());
+        frame.chunkSize = static_cast<uint16_t>(sender.chunkSize_);
+        frame.totalChunks =
+            static_cast<uint16_t>((jpeg.size() + sender.chunkSize_ - 1) / sender.chunkSize_);
+        frame.fecGroup = static_cast<uint8_t>(sender.config_.fecGroupSize);
+        sender.sendFrameToMulticast(jpeg, frame);
+    }
+
+    static void processPacket(Receiver& receiver, const uint8_t* data, size_t len) {
+        receiver.processPacket(data, len);
+    }
+};
+
+}  // namespace MulticastLib
+
+using namespace MulticastLib;
+using bench::makeFrame;
+using bench::measure;
+
+namespace {
+
+const int QUALITY = 80;
+const int MTUS[] = {576, 1500, 9000};
+const std::pair<int, int> RESOLUTIONS[] = {{640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+
+// Строка отчёта: имя бенчмарка с параметрами и числовые метрики
+struct Record {
+    std::string name;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+struct Options {
+    const char* jsonPath = nullptr;
+    std::string only;
+    int iterations = 100;
+    int receivers = 4;
+    double seconds = 5.0;
+    double fps = 60.0;
+    int width = 1920;
+    int height = 1080;
+};
+
+// Транспорт без сети: отправка только проставляет msg_len, а при capture копирует
+// датаграммы, чтобы подать их потом на вход Receiver'а
+class BenchTransport : public SenderTransport {
+   public:
+    explicit BenchTransport(std::vector<std::vector<uint8_t>>* capture) : capture_(capture) {}
+
+    bool open(std::chrono::microseconds) override { return true; }
+    void close() override {}
+
+    int sendBatch(struct mmsghdr* messages, unsigned int count) override {
+        for (unsigned int i = 0; i < count; ++i) {
+            const msghdr& msg = messages[i].msg_hdr;
+            size_t len = 0;
+            for (size_t j = 0; j < msg.msg_iovlen; ++j) len += msg.msg_iov[j].iov_len;
+            messages[i].msg_len = static_cast<unsigned int>(len);
+            if (!capture_) continue;
+            std::vector<uint8_t>& datagram = capture_->emplace_back();
+            datagram.reserve(len);
+            for (size_t j = 0; j < msg.msg_iovlen; ++j) {
+                auto* base = static_cast<const uint8_t*>(msg.msg_iov[j].iov_base);
+                datagram.insert(datagram.end(), base, base + msg.msg_iov[j].iov_len);
+            }
+        }
+        return static_cast<int>(count);
+    }
+
+    int receiveControl(struct mmsghdr*, unsigned int) override { return 0; }
+
+   private:
+    std::vector<std::vector<uint8_t>>* capture_;
+};
+
+std::string resolutionName(int width, int height) {
+    return std::to_string(width) + "x" + std::to_string(height);
+}
+
+std::unique_ptr<Sender> makeSender(int mtu, std::vector<std::vector<uint8_t>>* capture) {
+    SenderConfig config;
+    config.mtu = mtu;
+    config.source.type = FrameSourceType::Synthetic;
+    auto sender = std::make_unique<Sender>("239.0.0.1", 5000, config);
+    sender->setTransport(std::make_unique<BenchTransport>(capture));
+    return sender;
+}
+
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+uint64_t systemNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+void benchCodec(const Options& options, std::vector<Record>& records) {
+    for (auto [width, height] : RESOLUTIONS) {
+        std::vector<cv::Mat> frames;
+        for (int i = 0; i < 4; ++i) frames.push_back(makeFrame(width, height, i));
+        JpegEncoder encoder;
+        std::vector<uchar> jpeg;
+        double encodeMs = measure(options.iterations, [&](int i) {
+            encoder.encode(frames[i % frames.size()], QUALITY, jpeg);
+        });
+        JpegDecoder decoder;
+        cv::Mat decoded;
+        double decodeMs = measure(options.iterations,
+                                  [&](int) { decoder.decode(jpeg.data(), jpeg.size(), decoded); });
+        std::string resolution = resolutionName(width, height);
+        records.push_back({"encode/" + resolution,
+                           {{"ms", encodeMs},
+                            {"fps", 1000.0 / encodeMs},
+                            {"bytes", static_cast<double>(jpeg.size())}}});
+        records.push_back({"decode/" + resolution, {{"ms", decodeMs}, {"fps", 1000.0 / decodeMs}}});
+    }
+}
+
+void benchPacketize(const Options& options, std::vector<Record>& records) {
+    JpegEncoder encoder;
+    for (auto [width, height] : RESOLUTIONS) {
+        std::vector<uchar> jpeg;
+        encoder.encode(makeFrame(width, height, 0), QUALITY, jpeg);
+        for (int mtu : MTUS) {
+            std::vector<std::vector<uint8_t>> datagrams;
+            auto sender = makeSender(mtu, nullptr);
+            auto counter = makeSender(mtu, &datagrams);
+            BenchAccess::packetize(*counter, jpeg, 1);
+
+            uint32_t frameSeq = 0;
+            double ms = measure(options.iterations,
+                                [&](int) { BenchAccess::packetize(*sender, jpeg, ++frameSeq); });
+            double packets = static_cast<double>(datagrams.size());
+            records.push_back(
+                {"packetize/" + resolutionName(width, height) + "/mtu" + std::to_string(mtu),
+                 {{"ms", ms},
+                  {"packetsPerFrame", packets},
+                  {"packetsPerSec", packets * 1000.0 / ms},
+                  {"mbytesPerSec", jpeg.size() / 1e3 / ms}}});
+        }
+    }
+}
+
+void benchReassemble(const Options& options, std::vector<Record>& records) {
+    JpegEncoder encoder;
+    for (auto [width, height] : RESOLUTIONS) {
+        std::vector<uchar> jpeg;
+        encoder.encode(makeFrame(width, height, 0), QUALITY, jpeg);
+        for (int mtu : MTUS) {
+            std::vector<std::vector<uint8_t>> datagrams;
+            auto sender = makeSender(mtu, &datagrams);
+            BenchAccess::packetize(*sender, jpeg, 0);
+
+            // Приёмник не запущен: собранные кадры копятся в очереди декодирования, и
+            // самые старые из неё выбрасываются, возвращая слоты сборщику
+            ReceiverConfig config;
+            config.maxFrameSize = std::max(config.maxFrameSize, static_cast<int>(jpeg.size()));
+            Receiver receiver("239.0.0.1", 5000, config);
+
+            // Каждой итерации - новый номер кадра, иначе пакеты отсекаются как дубли
+            uint32_t frameSeq = 0;
+            double ms = measure(options.iterations, [&](int) {
+                uint32_t wire = htonl(++frameSeq);
+                for (auto& datagram : datagrams) {
+                    memcpy(datagram.data() + offsetof(ChunkHeader, frame_seq), &wire,
+                           sizeof(wire));
+                    BenchAccess::processPacket(receiver, datagram.data(), datagram.size());
+                }
+            });
+            double packets = static_cast<double>(datagrams.size());
+            ReceiverStatistics stats = receiver.getStatistics();
+            records.push_back(
+                {"reassemble/" + resolutionName(width, height) + "/mtu" + std::to_string(mtu),
+                 {{"ms", ms},
+                  {"packetsPerFrame", packets},
+                  {"packetsPerSec", packets * 1000.0 / ms},
+                  {"corruptedPackets", static_cast<double>(stats.totalCorruptedPackets)}}});
+        }
+    }
+}
+
+void benchLoopback(const Options& options, std::vector<Record>& records) {
+    LoopbackConfig networkConfig;
+    networkConfig.capacity = 16384;
+    auto network = std::make_shared<LoopbackNetwork>(networkConfig);
+
+    SenderConfig senderConfig;
+    senderConfig.targetFps = options.fps;
+    senderConfig.source.type = FrameSourceType::Synthetic;
+    senderConfig.source.width = options.width;
+    senderConfig.source.height = options.height;
+    Sender sender("239.0.0.1", 5000, senderConfig);
+    sender.setTransport(network->createSenderTransport());
+
+    // Задержка захват -> кадр у обработчика приёмника; часы у всех общие
+    LatencyHistogram latency;
+    std::vector<std::unique_ptr<Receiver>> receivers;
+    for (int i = 0; i < options.receivers; ++i) {
+        ReceiverConfig config;
+        config.maxFrameSize = std::max(config.maxFrameSize, options.width * options.height * 3);
+        auto receiver = std::make_unique<Receiver>("239.0.0.1", 5000, config);
+        receiver->setTransport(network->createReceiverTransport());
+        receiver->addFrameCallback([&latency](const FrameHandle& frame) {
+            uint64_t now = systemNowUs();
+            if (now > frame->captureTimestampUs) latency.record(now - frame->captureTimestampUs);
+        });
+        receiver->start();
+        receivers.push_back(std::move(receiver));
+    }
+    if (!sender.startStream()) {
+        fprintf(stderr, "loopback: failed to start sender\n");
+        return;
+    }
+
+    // Секунда на прогрев: очереди, пулы кадров, первые кадры у всех приёмников
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    auto framesReceived = [&] {
+        uint64_t total = 0;
+        for (auto& receiver : receivers) total += receiver->getStatistics().totalFramesDecoded;
+        return total;
+    };
+    latency.reset();
+    uint64_t sentBefore = sender.getStatistics().totalFramesSent;
+    uint64_t receivedBefore = framesReceived();
+    LoopbackStatistics networkBefore = network->getStatistics();
+    double cpuBefore = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+
+    double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = cpuSeconds() - cpuBefore;
+    double sent = static_cast<double>(sender.getStatistics().totalFramesSent - sentBefore);
+    double received = static_cast<double>(framesReceived() - receivedBefore);
+    LoopbackStatistics networkAfter = network->getStatistics();
+    LatencySummary summary = latency.summary();
+    sender.stopStream();
+    for (auto& receiver : receivers) receiver->stop();
+
+    double delivered =
+        static_cast<double>(networkAfter.packetsDelivered - networkBefore.packetsDelivered);
+    double overflowed =
+        static_cast<double>(networkAfter.packetsOverflowed - networkBefore.packetsOverflowed);
+    records.push_back({"loopback/" + resolutionName(options.width, options.height) + "/" +
+                           std::to_string(options.receivers) + "rx",
+                       {{"senderFps", sent / elapsed},
+                        {"receiverFps", received / elapsed / std::max(1, options.receivers)},
+                        {"packetsPerSec", delivered / elapsed},
+                        {"packetsOverflowed", overflowed},
+                        {"latencyP50Ms", summary.p50Ms},
+                        {"latencyP99Ms", summary.p99Ms},
+                        {"latencyMaxMs", summary.maxMs},
+                        {"cpuMsPerFrame", sent > 0 ? cpu * 1000.0 / sent : 0.0},
+                        {"cpuCores", cpu / elapsed}}});
+}
+
+// Один Sender и один Receiver в процессе через multicast на локальной машине: системные
+// вызовы и CPU на кадр для каждого доступного бэкенда ввода-вывода, с UDP GSO/GRO и без
+void benchUdp(const Options& options, std::vector<Record>& records) {
+    struct Variant {
+        const char* name;
+        IoBackend backend;
+        bool offload;
+    };
+    std::vector<Variant> variants = {{"sockets", IoBackend::Sockets, false},
+                                     {"sockets+gso", IoBackend::Sockets, true}};
+    if (ioUringSupported()) {
+        variants.push_back({"io_uring", IoBackend::IoUring, false});
+        variants.push_back({"io_uring+gso", IoBackend::IoUring, true});
+    }
+
+    for (const Variant& variant : variants) {
+        SenderConfig senderConfig;
+        senderConfig.targetFps = options.fps;
+        senderConfig.ioBackend = variant.backend;
+        senderConfig.segmentationOffload = variant.offload;
+        senderConfig.source.type = FrameSourceType::Synthetic;
+        senderConfig.source.width = options.width;
+        senderConfig.source.height = options.height;
+        Sender sender("239.255.0.77", 5077, senderConfig);
+
+        ReceiverConfig receiverConfig;
+        receiverConfig.ioBackend = variant.backend;
+        receiverConfig.receiveOffload = variant.offload;
+        receiverConfig.maxFrameSize =
+            std::max(receiverConfig.maxFrameSize, options.width * options.height * 3);
+        Receiver receiver("239.255.0.77", 5077, receiverConfig);
+        if (!receiver.start() || !sender.startStream()) {
+            fprintf(stderr, "udp/%s: failed to start\n", variant.name);
+            receiver.stop();
+            continue;
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        SenderStatistics senderBefore = sender.getStatistics();
+        ReceiverStatistics receiverBefore = receiver.getStatistics();
+        double cpuBefore = cpuSeconds();
+        auto start = std::chrono::steady_clock::now();
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+
+        double elapsed =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double cpu = cpuSeconds() - cpuBefore;
+        SenderStatistics senderAfter = sender.getStatistics();
+        ReceiverStatistics receiverAfter = receiver.getStatistics();
+        sender.stopStream();
+        receiver.stop();
+
+        double sent = static_cast<double>(senderAfter.totalFramesSent -
+                                          senderBefore.totalFramesSent);
+        double received = static_cast<double>(receiverAfter.totalFramesDecoded -
+                                              receiverBefore.totalFramesDecoded);
+        double txSyscalls =
+            static_cast<double>(senderAfter.totalSyscalls - senderBefore.totalSyscalls);
+        double rxSyscalls = static_cast<double>(receiverAfter.totalReceiveSyscalls -
+                                                receiverBefore.totalReceiveSyscalls);
+        double packets = static_cast<double>(receiverAfter.totalPacketsReceived -
+                                             receiverBefore.totalPacketsReceived);
+        records.push_back(
+            {std::string("udp/") + variant.name + "/" +
+                 resolutionName(options.width, options.height),
+             {{"senderFps", sent / elapsed},
+              {"receiverFps", received / elapsed},
+              {"packetsPerFrame", sent > 0 ? packets / sent : 0.0},
+              {"senderSyscallsPerFrame", sent > 0 ? txSyscalls / sent : 0.0},
+              {"receiverSyscallsPerFrame", received > 0 ? rxSyscalls / received : 0.0},
+              {"cpuMsPerFrame", sent > 0 ? cpu * 1000.0 / sent : 0.0}}});
+    }
+}
+
+void printRecord(FILE* out, const Record& record) {
+    fprintf(out, "%-34s", record.name.c_str());
+    for (auto& [key, value] : record.metrics) fprintf(out, " %s=%.4g", key.c_str(), value);
+    fprintf(out, "\n");
+}
+
+bool writeJson(const char* path, const std::vector<Record>& records) {
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!out) return false;
+    fprintf(out, "{\n  \"timestamp\": %lld,\n", static_cast<long long>(time(nullptr)));
+    fprintf(out, "  \"cores\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(out, "  \"turbojpeg\": %s,\n", jpegCodecAccelerated() ? "true" : "false");
+    fprintf(out, "  \"results\": [");
+    for (size_t i = 0; i < records.size(); ++i) {
+        fprintf(out, "%s\n    {\"name\": \"%s\"", i ? "," : "", records[i].name.c_str());
+        for (auto& [key, value] : records[i].metrics) {
+            fprintf(out, ", \"%s\": %.6g", key.c_str(), value);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    return out == stdout || fclose(out) == 0;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) return false;
+        ++i;
+        if (strcmp(arg, "--json") == 0) {
+            options.jsonPath = value;
+        } else if (strcmp(arg, "--only") == 0) {
+            options.only = value;
+        } else if (strcmp(arg, "--iterations") == 0) {
+            options.iterations = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--receivers") == 0) {
+            options.receivers = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--seconds") == 0) {
+            options.seconds = std::max(0.1, atof(value));
+        } else if (strcmp(arg, "--fps") == 0) {
+            options.fps = std::max(1.0, atof(value));
+        } else if (strcmp(arg, "--resolution") == 0) {
+            if (sscanf(value, "%dx%d", &options.width, &options.height) != 2) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr,
+                "usage: %s [--json file|-] [--iterations N] [--only codec|packetize|"
+                "reassemble|loopback|udp] [--receivers N] [--seconds S] [--fps F] "
+                "[--resolution WxH]\n",
+                argv[0]);
+        return 2;
+    }
+    // Журнал Receiver'ов и Sender'ов не должен мешать замерам и отчёту
+    setLogLevel(LogLevel::Warning);
+
+    // С JSON в stdout таблица уходит в stderr
+    FILE* table = options.jsonPath && strcmp(options.jsonPath, "-") == 0 ? stderr : stdout;
+    fprintf(table, "%u cores, libjpeg-turbo: %s, %d iterations\n",
+            std::thread::hardware_concurrency(), jpegCodecAccelerated() ? "yes" : "no",
+            options.iterations);
+
+    std::vector<Record> records;
+    auto run = [&](const char* group, void (*body)(const Options&, std::vector<Record>&)) {
+        if (!options.only.empty() && options.only != group) return;
+        size_t first = records.size();
+        body(options, records);
+        for (size_t i = first; i < records.size(); ++i) printRecord(table, records[i]);
+        fflush(table);
+    };
+    run("codec", benchCodec);
+    run("packetize", benchPacketize);
+    run("reassemble", benchReassemble);
+    run("loopback", benchLoopback);
+    run("udp", benchUdp);
+
+    if (options.jsonPath && !writeJson(options.jsonPath, records)) {
+        fprintf(stderr, "failed to write %s\n", options.jsonPath);
+        return 1;
+    }
+    return 0;
+}
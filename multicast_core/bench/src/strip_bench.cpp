@@ -0,0 +1,92 @@
+// Масштабирование кодирования и декодирования полосами по числу потоков.
+// Запуск: strip_bench [ширина высота кадров полос], по умолчанию 3840 2160 100 16
+#include <jpeg_codec.h>
+#include <protocol.h>
+#include <strip_encoder.h>
+#include <worker_pool.h>
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+
+using namespace MulticastLib;
+using bench::makeFrame;
+using bench::measure;
+
+int main(int argc, char** argv) {
+    int width = argc > 2 ? atoi(argv[1]) : 3840;
+    int height = argc > 2 ? atoi(argv[2]) : 2160;
+    int iterations = argc > 3 ? atoi(argv[3]) : 100;
+    int stripCount = argc > 4 ? atoi(argv[4]) : 16;
+    const int quality = 80;
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < 4; ++i) frames.push_back(makeFrame(width, height, i));
+    printf("%dx%d, %d strips, %d iterations, %d cores, libjpeg-turbo: %s\n", width, height,
+           stripCount, iterations, cores, jpegCodecAccelerated() ? "yes" : "no");
+
+    // Базовая линия - кадр целиком одним кодером, как без stripCount
+    JpegEncoder encoder;
+    std::vector<uchar> whole;
+    double wholeEncode = measure(
+        iterations, [&](int i) { encoder.encode(frames[i % frames.size()], quality, whole); });
+    JpegDecoder decoder;
+    cv::Mat decoded;
+    double wholeDecode =
+        measure(iterations, [&](int) { decoder.decode(whole.data(), whole.size(), decoded); });
+    printf("%-8s %10s %10s %8s %10s %10s %8s\n", "threads", "enc ms", "enc fps", "speedup",
+           "dec ms", "dec fps", "speedup");
+    printf("%-8s %10.3f %10.1f %8s %10.3f %10.1f %8s\n", "whole", wholeEncode,
+           1000.0 / wholeEncode, "1.00x", wholeDecode, 1000.0 / wholeDecode, "1.00x");
+
+    for (int threads = 1; threads <= std::min(cores, stripCount); threads *= 2) {
+        StripEncoder stripEncoder(stripCount, threads);
+        std::vector<uchar> container;
+        uint8_t flags = 0;
+        double encodeMs = measure(iterations, [&](int i) {
+            stripEncoder.encode(frames[i % frames.size()], quality, container, &flags);
+        });
+
+        // Декодирование как у Receiver: разбор контейнера, полосы на пуле, склейка в холст
+        std::vector<SegmentHeader> headers;
+        std::vector<const uint8_t*> jpegs;
+        for (size_t offset = 0; offset + sizeof(SegmentHeader) <= container.size();) {
+            SegmentHeader header;
+            memcpy(&header, container.data() + offset, sizeof(header));
+            offset += sizeof(header);
+            headers.push_back(header);
+            jpegs.push_back(container.data() + offset);
+            offset += ntohl(header.jpeg_size);
+        }
+        WorkerPool pool(threads);
+        std::vector<std::unique_ptr<JpegDecoder>> decoders;
+        for (size_t i = 0; i < pool.size(); ++i) {
+            decoders.push_back(std::make_unique<JpegDecoder>());
+        }
+        std::vector<cv::Mat> strips(headers.size());
+        cv::Mat canvas(height, width, CV_8UC3);
+        double decodeMs = measure(iterations, [&](int) {
+            pool.run(headers.size(), [&](size_t strip, size_t worker) {
+                cv::Mat& image = strips[strip];
+                int y = ntohs(headers[strip].y);
+                decoders[worker]->decode(jpegs[strip], ntohl(headers[strip].jpeg_size), image);
+                image.copyTo(canvas.rowRange(y, y + image.rows));
+            });
+        });
+
+        printf("%-8d %10.3f %10.1f %7.2fx %10.3f %10.1f %7.2fx\n", threads, encodeMs,
+               1000.0 / encodeMs, wholeEncode / encodeMs, decodeMs, 1000.0 / decodeMs,
+               wholeDecode / decodeMs);
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+# Необязательные зависимости multicast_core. Общий модуль для сборки C++ библиотеки
+# (multicast_core/CMakeLists.txt) и python-модуля (CMakeLists.txt в корне): поиск
+# делается здесь один раз, цели только подключают найденное
+
+# libjpeg-turbo (TurboJPEG API) необязателен: без него кодек работает через OpenCV
+find_path(TURBOJPEG_INCLUDE_DIR turbojpeg.h)
+find_library(TURBOJPEG_LIBRARY NAMES turbojpeg)
+if(TURBOJPEG_INCLUDE_DIR AND TURBOJPEG_LIBRARY)
+    set(MULTICAST_HAVE_TURBOJPEG ON)
+    message(STATUS "Using libjpeg-turbo: ${TURBOJPEG_LIBRARY}")
+else()
+    set(MULTICAST_HAVE_TURBOJPEG OFF)
+endif()
+
+# liburing (2.4+) необязателен: без него IoBackend::IoUring работает через сокеты.
+# Multishot recvmsg требует ядра 6.0+, на старых приём откатывается на recvmmsg
+find_path(LIBURING_INCLUDE_DIR liburing.h)
+find_library(LIBURING_LIBRARY NAMES uring)
+if(LIBURING_INCLUDE_DIR AND LIBURING_LIBRARY)
+    set(MULTICAST_HAVE_LIBURING ON)
+    message(STATUS "Using liburing: ${LIBURING_LIBRARY}")
+else()
+    set(MULTICAST_HAVE_LIBURING OFF)
+endif()
+
+# Подключает к цели все найденные необязательные зависимости
+function(multicast_link_optional_dependencies target)
+    if(MULTICAST_HAVE_TURBOJPEG)
+        target_compile_definitions(${target} PRIVATE MULTICAST_HAVE_TURBOJPEG)
+        target_include_directories(${target} PRIVATE ${TURBOJPEG_INCLUDE_DIR})
+        target_link_libraries(${target} PRIVATE ${TURBOJPEG_LIBRARY})
+    endif()
+    if(MULTICAST_HAVE_LIBURING)
+        target_compile_definitions(${target} PRIVATE MULTICAST_HAVE_LIBURING)
+        target_include_directories(${target} PRIVATE ${LIBURING_INCLUDE_DIR})
+        target_link_libraries(${target} PRIVATE ${LIBURING_LIBRARY})
+    endif()
+endfunction()
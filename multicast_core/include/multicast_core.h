@@ -1,6 +1,7 @@
 #ifndef MULTICAST_CORE_H
 #define MULTICAST_CORE_H
 
+#include "multicast_core_bits/logging.h"
 #include "multicast_core_bits/receiver.h"
 #include "multicast_core_bits/sender.h"
 
@@ -0,0 +1,74 @@
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace MulticastLib {
+
+// Ключ клиента: 64-битный FNV-1a от его ID, считается без выделения памяти
+uint64_t clientKey(std::string_view clientID);
+
+// Реестр клиентов Sender'а по heartbeat'ам. Клиенты лежат в хеш-таблице по ключу, а
+// истечение отслеживается колесом таймеров: клиент стоит в ячейке своего дедлайна и
+// проверяется, только когда колесо до неё доходит. Если heartbeat'ы шли, клиент
+// переставляется в ячейку нового дедлайна, иначе удаляется. heartbeat() - O(1), обход
+// колеса - O(клиентов в пройденных ячейках), то есть каждый клиент проверяется примерно
+// раз за timeout. Худшая доля потерь берётся из гистограммы, без обхода клиентов.
+// Изменяется одним потоком; size() и worstLossRatio() можно читать из любого.
+class ClientRegistry {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using ExpireCallback = std::function<void(uint64_t key)>;
+
+    ClientRegistry(Clock::duration timeout, Clock::duration tick);
+
+    // Отмечает heartbeat клиента. true - клиент новый
+    bool heartbeat(uint64_t key, double lossRatio, double fps, Clock::time_point now);
+
+    // Продвигает колесо до now и удаляет клиентов без heartbeat'ов дольше timeout
+    size_t expire(Clock::time_point now, const ExpireCallback& onExpire);
+
+    void clear();
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+    double worstLossRatio() const { return worstLoss_.load(std::memory_order_relaxed); }
+
+   private:
+    struct Client {
+        Clock::time_point lastHeartbeat;
+        double fps = 0.0;
+        uint16_t lossBucket = 0;
+    };
+
+    size_t slotFor(Clock::time_point deadline) const;
+    void setLossBucket(Client& client, uint16_t bucket);
+    void addToLossBucket(size_t bucket);
+    void removeFromLossBucket(size_t bucket);
+
+    Clock::duration timeout_;
+    Clock::duration tick_;
+    // Колесо покрывает timeout с запасом в ячейку; currentTick_ - последний пройденный тик
+    std::vector<std::vector<uint64_t>> wheel_;
+    int64_t currentTick_ = -1;
+    std::vector<uint64_t> expiring_;
+
+    std::unordered_map<uint64_t, Client> clients_;
+    // Число клиентов по долям потерь с шагом 1 / (lossHistogram_.size() - 1) и ячейка
+    // худшего из них
+    std::vector<uint32_t> lossHistogram_;
+    size_t worstBucket_ = 0;
+
+    std::atomic<size_t> size_{0};
+    std::atomic<double> worstLoss_{0.0};
+};
+
+}  // namespace MulticastLib
+
+#endif  // CLIENT_REGISTRY_H
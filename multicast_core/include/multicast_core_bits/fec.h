@@ -0,0 +1,20 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MulticastLib {
+
+// dst ^= src на len байтах. Ядро выбирается при первом вызове по возможностям CPU
+// (AVX2 / SSE2 / NEON), иначе скалярный вариант по 8 байт.
+void xorInto(uint8_t* dst, const uint8_t* src, size_t len);
+
+// Чётность группы чанков: parity = XOR всех чанков, короткие дополняются нулями до
+// chunkSize. Потеря любого одного чанка группы восстанавливается обратным XOR'ом.
+void computeParity(uint8_t* parity, const uint8_t* const* chunks, const size_t* lengths,
+                   size_t count, size_t chunkSize);
+
+}  // namespace MulticastLib
+
+#endif  // FEC_H
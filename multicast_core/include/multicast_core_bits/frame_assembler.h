@@ -0,0 +1,145 @@
+#ifndef FRAME_ASSEMBLER_H
+#define FRAME_ASSEMBLER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "protocol.h"
+
+namespace MulticastLib {
+
+// Собранный кадр: указывает прямо в буфер слота, валиден до release(slot)
+struct CompletedFrame {
+    size_t slot = 0;
+    // Номер кадра, развёрнутый в 64 бита: монотонен и через переполнение frame_seq
+    uint64_t sequence = 0;
+    uint32_t frameSeq = 0;
+    uint64_t captureTimestampUs = 0;
+    // Флаги кадра (CHUNK_FRAME_FLAGS)
+    uint8_t flags = 0;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint16_t totalChunks = 0;
+    uint16_t chunkSize = 0;
+    // Пришедшие и восстановленные чанки. У кадра из collectPartial() chunkBitmap -
+    // маска пришедших чанков, у собранного целиком - nullptr
+    uint16_t receivedChunks = 0;
+    const uint64_t* chunkBitmap = nullptr;
+    // Приход первого и последнего пакета кадра, задержки стадий Sender'а из заголовка
+    std::chrono::steady_clock::time_point firstPacketTime;
+    std::chrono::steady_clock::time_point lastPacketTime;
+    uint32_t encodeDelayUs = 0;
+    uint32_t sendDelayUs = 0;
+};
+
+// Запрос недостающих чанков одного кадра: до MAX_NACK_RANGES включительных диапазонов
+struct NackRequest {
+    uint32_t frameSeq = 0;
+    size_t rangeCount = 0;
+    uint16_t ranges[MAX_NACK_RANGES][2] = {};
+};
+
+// Сборщик кадров на фиксированном пуле слотов. Каждый слот - непрерывный буфер
+// на maxFrameSize байт, чанк пишется сразу по своему смещению, приход чанков
+// отмечается в битовой маске. Кадр с номером N собирается в слоте N % slotCount,
+// поэтому поиск слота - O(1), а опоздавшие пакеты старых кадров отсекаются сравнением
+// номеров. После конструирования память не выделяется.
+// Сборка ведётся одним потоком; release() можно вызывать из любого потока.
+class FrameAssembler {
+   public:
+    // Stale - пакет кадра, который уже собран, сброшен или вытеснен более новым
+    enum class Result { Incomplete, Completed, Duplicate, Stale, Rejected };
+
+    using Clock = std::chrono::steady_clock;
+    using DropCallback = std::function<void(uint32_t frameSeq, uint16_t lostChunks)>;
+
+    FrameAssembler(size_t slotCount, size_t maxFrameSize);
+
+    // Заголовок уже проверен parseChunkHeader; здесь - согласованность с остальными
+    // пакетами кадра и ограничения пула
+    Result addChunk(const ChunkInfo& info, const uint8_t* payload, CompletedFrame* completed);
+
+    // Пакет чётности группы: XOR fecGroup чанков данных, дополненных до chunkSize.
+    // Если в группе не хватает ровно одного чанка, он восстанавливается на месте
+    Result addParity(const ChunkInfo& info, const uint8_t* parity, CompletedFrame* completed);
+
+    // Возвращает слот собранного кадра в пул
+    void release(size_t slot);
+
+    // Сбрасывает незавершённые кадры, не обновлявшиеся с момента olderThan
+    void dropExpired(Clock::time_point olderThan, const DropCallback& onDrop);
+
+    // Собирает NACK'и для кадров, в которые чанки не приходили дольше quietTime.
+    // На кадр не чаще раза в retryInterval и не больше maxRetries раз
+    size_t collectNacks(Clock::time_point now, Clock::duration quietTime,
+                        Clock::duration retryInterval, int maxRetries, NackRequest* out,
+                        size_t maxRequests);
+
+    // Отдаёт недособранные кадры с сегментами по границам чанков (CHUNK_FLAG_ALIGNED),
+    // в которые чанки не приходили дольше quietTime. Слот переходит в Completed, как
+    // у собранного кадра, и возвращается в пул через release()
+    size_t collectPartial(Clock::time_point now, Clock::duration quietTime,
+                          CompletedFrame* out, size_t maxFrames);
+
+    size_t inFlightFrames() const;
+    // Кадры, сброшенные по таймауту или вытесненные более новыми
+    uint64_t droppedFrames() const { return droppedFrames_; }
+    // Чанки, восстановленные по чётности
+    uint64_t recoveredChunks() const { return recoveredChunks_; }
+
+   private:
+    enum class SlotState { Free, Assembling, Completed };
+
+    struct Slot {
+        std::atomic<SlotState> state{SlotState::Free};
+        // Номер последнего кадра в слоте сохраняется и после освобождения
+        uint64_t sequence = 0;
+        uint32_t frameSeq = 0;
+        uint64_t captureTimestampUs = 0;
+        uint16_t totalChunks = 0;
+        uint16_t receivedChunks = 0;
+        uint16_t chunkSize = 0;
+        uint8_t flags = 0;
+        size_t frameSize = 0;
+        uint32_t encodeDelayUs = 0;
+        uint32_t sendDelayUs = 0;
+        // Приход первого пакета кадра и последнего на данный момент
+        Clock::time_point firstTimestamp;
+        Clock::time_point timestamp;
+        std::unique_ptr<uint8_t[]> data;
+        std::vector<uint64_t> bitmap;
+        // FEC: чётность групп подряд по chunkSize байт, 0 в fecGroup - без FEC
+        uint16_t fecGroup = 0;
+        std::unique_ptr<uint8_t[]> parity;
+        std::vector<uint64_t> parityBitmap;
+        // NACK: время последнего запроса и число запросов
+        Clock::time_point lastNack;
+        int nackCount = 0;
+    };
+
+    uint64_t unwrapSequence(uint32_t frameSeq);
+    Slot* slotFor(const ChunkInfo& info, Result* result);
+    void tryRecover(Slot& slot, size_t group);
+    Result finish(Slot& slot, CompletedFrame* completed);
+    void complete(Slot& slot, CompletedFrame* completed);
+    size_t chunkLength(const Slot& slot, size_t chunk) const;
+
+    std::vector<Slot> slots_;
+    size_t maxFrameSize_;
+    size_t maxChunks_;
+    // Самый новый номер кадра на проводе и его развёрнутое значение
+    bool hasNewest_ = false;
+    uint32_t newestFrameSeq_ = 0;
+    uint64_t newestSequence_ = 0;
+    uint64_t droppedFrames_ = 0;
+    uint64_t recoveredChunks_ = 0;
+};
+
+}  // namespace MulticastLib
+
+#endif  // FRAME_ASSEMBLER_H
@@ -0,0 +1,139 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace MulticastLib {
+
+// Ограниченная lock-free очередь между стадиями конвейера (кольцо с
+// последовательными номерами ячеек). Рассчитана на одного писателя и одного
+// читателя, но писатель может сам вынуть самый старый элемент, чтобы
+// освободить место (политика drop-oldest), - поэтому извлечение сделано через CAS.
+template <typename T>
+class FrameQueue {
+   public:
+    explicit FrameQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    // item перемещается только при успешной вставке
+    bool tryPush(T&& item) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Кладёт элемент, при переполнении выбрасывая самые старые. Возвращает число выброшенных
+    size_t pushDropOldest(T&& item) {
+        size_t dropped = 0;
+        while (!tryPush(std::move(item))) {
+            T stale;
+            if (tryPop(stale)) dropped++;
+        }
+        return dropped;
+    }
+
+    // Ждёт свободного места не дольше timeout (политика блокирования писателя)
+    template <typename Rep, typename Period>
+    bool pushWait(T&& item, std::chrono::duration<Rep, Period> timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (int spins = 0; !tryPush(std::move(item)); ++spins) {
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            backoff(spins);
+        }
+        return true;
+    }
+
+    // Ждёт элемента не дольше timeout
+    template <typename Rep, typename Period>
+    bool popWait(T& item, std::chrono::duration<Rep, Period> timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (int spins = 0; !tryPop(item); ++spins) {
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            backoff(spins);
+        }
+        return true;
+    }
+
+    size_t size() const {
+        size_t head = dequeuePos_.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+   private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static void backoff(int spins) {
+        if (spins < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+};
+
+}  // namespace MulticastLib
+
+#endif  // FRAME_QUEUE_H
@@ -0,0 +1,141 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+namespace MulticastLib {
+
+enum class FrameSourceType { Camera, VideoFile, RawFile, Synthetic };
+
+struct FrameSourceConfig {
+    FrameSourceType type = FrameSourceType::Camera;
+    int cameraIndex = 0;
+    // VideoFile и RawFile: путь к файлу; с loop по окончании файл идёт сначала
+    std::string path;
+    bool loop = true;
+    // RawFile и Synthetic: размер кадра. RawFile - кадры BGR24 подряд, без заголовков
+    int width = 1280;
+    int height = 720;
+    // Synthetic: доля строк кадра, которые сдвигаются каждый кадр (0 - статичная сцена,
+    // 1 - панорама на весь кадр)
+    double motion = 0.5;
+};
+
+// Источник кадров Sender'а. Вызывается только из потока захвата; темп задаёт Sender
+class FrameSource {
+   public:
+    virtual ~FrameSource() = default;
+
+    virtual bool open() = 0;
+    // Следующий кадр BGR24 в пустой Mat: буфер каждый раз новый, прошлые кадры ещё
+    // могут держать превью и очередь кодирования
+    virtual bool read(cv::Mat& image) = 0;
+    virtual void close() = 0;
+    // Кадры кончились и больше не появятся (файл без loop)
+    virtual bool exhausted() const { return false; }
+    virtual std::string name() const = 0;
+};
+
+std::unique_ptr<FrameSource> makeFrameSource(const FrameSourceConfig& config);
+
+class CameraSource : public FrameSource {
+   public:
+    explicit CameraSource(int index);
+
+    bool open() override;
+    bool read(cv::Mat& image) override;
+    void close() override;
+    std::string name() const override;
+
+   private:
+    int index_;
+    cv::VideoCapture camera_;
+};
+
+// Видеофайл, декодируется OpenCV
+class VideoFileSource : public FrameSource {
+   public:
+    VideoFileSource(const std::string& path, bool loop);
+
+    bool open() override;
+    bool read(cv::Mat& image) override;
+    void close() override;
+    bool exhausted() const override { return exhausted_; }
+    std::string name() const override { return path_; }
+
+   private:
+    std::string path_;
+    bool loop_;
+    bool exhausted_ = false;
+    cv::VideoCapture capture_;
+};
+
+// Несжатые кадры из файла, отображённого в память: чтение кадра - одно копирование из
+// page cache, без декодирования и системных вызовов
+class RawFileSource : public FrameSource {
+   public:
+    RawFileSource(const std::string& path, int width, int height, bool loop);
+    ~RawFileSource() override;
+
+    bool open() override;
+    bool read(cv::Mat& image) override;
+    void close() override;
+    bool exhausted() const override { return exhausted_; }
+    std::string name() const override { return path_; }
+
+   private:
+    std::string path_;
+    int width_;
+    int height_;
+    bool loop_;
+    bool exhausted_ = false;
+    const uint8_t* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    size_t frameBytes_ = 0;
+    size_t frameCount_ = 0;
+    size_t nextFrame_ = 0;
+};
+
+// Детерминированный тестовый сигнал: текстура с шумом, верхняя доля motion строк
+// сдвигается каждый кадр, в левом верхнем углу - номер кадра двоичными клетками.
+// Одинаковые параметры дают одинаковую последовательность кадров на любой машине
+class SyntheticSource : public FrameSource {
+   public:
+    SyntheticSource(int width, int height, double motion);
+
+    bool open() override;
+    bool read(cv::Mat& image) override;
+    void close() override {}
+    std::string name() const override { return "synthetic"; }
+
+   private:
+    int width_;
+    int height_;
+    int movingRows_;
+    cv::Mat background_;
+    uint64_t frameIndex_ = 0;
+};
+
+// Темп по абсолютным дедлайнам: ошибка сна не накапливается. Последний участок до
+// дедлайна поток не спит, а уступает процессор в цикле - sleep_until будит с опозданием
+// на timer slack, десятки микросекунд
+class FramePacer {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    // Начинает отсчёт; уменьшает timer slack вызывающего потока
+    void start();
+    // Ждёт следующий дедлайн. false - отстали больше чем на кадр, отсчёт начат заново
+    bool waitNext(Clock::duration interval);
+
+   private:
+    Clock::time_point deadline_;
+};
+
+}  // namespace MulticastLib
+
+#endif  // FRAME_SOURCE_H
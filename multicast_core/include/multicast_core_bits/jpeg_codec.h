@@ -0,0 +1,74 @@
+#ifndef JPEG_CODEC_H
+#define JPEG_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace MulticastLib {
+
+// true, если библиотека собрана с libjpeg-turbo
+bool jpegCodecAccelerated();
+
+// Потолок размера декодируемого кадра в пикселях (8K с запасом). Размеры берутся из
+// заголовка JPEG, пришедшего из сети: без потолка подделанный заголовок 65535x65535
+// заставил бы выделить гигабайты
+constexpr size_t JPEG_MAX_DECODE_PIXELS = 8192 * 8192;
+
+// Кодер JPEG с постоянным контекстом. При сборке с libjpeg-turbo
+// (MULTICAST_HAVE_TURBOJPEG) держит хэндл TurboJPEG и заранее выделенный буфер
+// сжатия, в out копируется только результат; иначе вызывает cv::imencode.
+// Ёмкость out переиспользуется между кадрами.
+// Один объект - один поток.
+class JpegEncoder {
+   public:
+    JpegEncoder();
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    // BGR-изображение, в том числе ROI большего кадра
+    bool encode(const cv::Mat& image, int quality, std::vector<uchar>& out);
+
+   private:
+    void* handle_ = nullptr;
+    // Буфер TurboJPEG под худший случай для текущего размера кадра
+    unsigned char* buffer_ = nullptr;
+    unsigned long bufferSize_ = 0;
+    std::vector<int> params_;
+};
+
+// Декодер JPEG с постоянным контекстом. Результат пишется в переданный Mat: если его
+// размер и тип уже подходят, буфер переиспользуется без выделения памяти.
+// Один объект - один поток.
+class JpegDecoder {
+   public:
+    // Кадры больше maxPixels не декодируются. Ошибки декодера и нехватка памяти
+    // возвращаются как false, исключения наружу не выходят
+    explicit JpegDecoder(size_t maxPixels = JPEG_MAX_DECODE_PIXELS);
+    ~JpegDecoder();
+
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    // Декодирует в BGR (CV_8UC3)
+    bool decode(const uint8_t* data, size_t size, cv::Mat& out);
+
+    // Декодирует в I420 (CV_8UC1, rows = высота * 3 / 2) без преобразования в BGR, если
+    // кадр сжат с субдискретизацией 4:2:0; иначе - через BGR
+    bool decodeYuv(const uint8_t* data, size_t size, cv::Mat& out);
+
+   private:
+    bool decodeBgr(const uint8_t* data, size_t size, cv::Mat& out);
+    bool decodeI420(const uint8_t* data, size_t size, cv::Mat& out);
+
+    void* handle_ = nullptr;
+    size_t maxPixels_;
+    cv::Mat bgr_;
+};
+
+}  // namespace MulticastLib
+
+#endif  // JPEG_CODEC_H
@@ -0,0 +1,51 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace MulticastLib {
+
+// Квантили задержки в миллисекундах
+struct LatencySummary {
+    uint64_t count = 0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double p999Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+// Гистограмма задержек в микросекундах в духе HDR Histogram: каждый диапазон
+// [2^k, 2^(k+1)) делится на LATENCY_SUB_BUCKETS равных корзин, поэтому относительная
+// погрешность квантилей не больше 1/LATENCY_SUB_BUCKETS при любом масштабе.
+// record() - несколько атомарных операций без блокировок, писать и читать можно из
+// любых потоков; summary() видит согласованную с точностью до одновременных записей картину
+class LatencyHistogram {
+   public:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    // Значения от 2^40 мкс (~12 суток) попадают в последнюю корзину
+    static constexpr size_t MAX_EXPONENT = 40;
+    static constexpr size_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    void record(uint64_t valueUs);
+    LatencySummary summary() const;
+    void reset();
+
+   private:
+    static size_t bucketIndex(uint64_t value);
+    // Середина корзины - значение, которым она представлена в квантилях
+    static uint64_t bucketValue(size_t index);
+
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+}  // namespace MulticastLib
+
+#endif  // LATENCY_HISTOGRAM_H
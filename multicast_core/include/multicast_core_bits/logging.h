@@ -0,0 +1,115 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Уровни ниже этого не компилируются вовсе (0 - Trace ... 4 - Error)
+#ifndef MULTICAST_LOG_MIN_LEVEL
+#define MULTICAST_LOG_MIN_LEVEL 0
+#endif
+
+// 0 - вызовы трассировки не компилируются
+#ifndef MULTICAST_TRACE_ENABLED
+#define MULTICAST_TRACE_ENABLED 1
+#endif
+
+namespace MulticastLib {
+
+enum class LogLevel : int { Trace = 0, Debug, Info, Warning, Error, Off };
+
+constexpr size_t LOG_MESSAGE_SIZE = 192;
+
+// Запись журнала в том виде, в каком её получает приёмник (LogSink)
+struct LogRecord {
+    LogLevel level = LogLevel::Info;
+    // Время записи, мкс от эпохи system_clock, и номер потока в журнале
+    int64_t timestampUs = 0;
+    uint32_t threadId = 0;
+    char message[LOG_MESSAGE_SIZE] = {};
+};
+
+// Приёмник записей; вызывается фоновым потоком журнала. Без приёмника записи пишутся
+// в stderr пачками, одним вызовом на проход
+using LogSink = std::function<void(const LogRecord& record)>;
+
+// Журнал: вызывающий поток только форматирует запись в свой кольцевой буфер без
+// блокировок, а печатает их фоновый поток. Если буфер потока переполнен, запись
+// теряется и учитывается в droppedLogRecords(). С одного места в коде проходит не
+// больше setLogRateLimit() записей в секунду, остальные считаются и упоминаются
+// в следующей записи с этого места
+void setLogLevel(LogLevel level);
+LogLevel getLogLevel();
+void setLogRateLimit(int recordsPerSecond);
+void setLogSink(LogSink sink);
+uint64_t droppedLogRecords();
+// Дожидается, пока фоновый поток выведет всё записанное до вызова
+void flushLog();
+
+// Трассировка стадий в формате Chrome trace (JSON, открывается в chrome://tracing и
+// Perfetto). Интервалы пишутся тем же фоновым потоком; пока трассировка выключена,
+// вызов traceSpan стоит одной атомарной загрузки
+bool startTrace(const std::string& path);
+void stopTrace();
+
+namespace detail {
+
+inline std::atomic<int> logLevel{static_cast<int>(LogLevel::Info)};
+inline std::atomic<bool> traceEnabled{false};
+
+// Состояние ограничения частоты для одного места вызова
+struct LogSite {
+    std::atomic<int64_t> windowStartUs{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+void write(LogLevel level, LogSite& site, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+void writeSpan(const char* name, const char* category,
+               std::chrono::steady_clock::time_point start,
+               std::chrono::steady_clock::time_point end, uint64_t id);
+
+}  // namespace detail
+
+inline bool logEnabled(LogLevel level) {
+    return static_cast<int>(level) >= detail::logLevel.load(std::memory_order_relaxed);
+}
+
+// Интервал стадии name (capture, encode, send, reassemble, decode...). Библиотека
+// передаёт в id время захвата кадра: оно одно у всех стадий и у Sender'а, и у Receiver'а
+inline void traceSpan(const char* name, const char* category,
+                      std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end, uint64_t id) {
+#if MULTICAST_TRACE_ENABLED
+    if (detail::traceEnabled.load(std::memory_order_relaxed)) {
+        detail::writeSpan(name, category, start, end, id);
+    }
+#else
+    (void)name, (void)category, (void)start, (void)end, (void)id;
+#endif
+}
+
+}  // namespace MulticastLib
+
+// Запись в журнал в стиле printf. Аргументы не вычисляются, если уровень выключен
+#define MULTICAST_LOG(level, ...)                                           \
+    do {                                                                    \
+        if constexpr (static_cast<int>(level) >= MULTICAST_LOG_MIN_LEVEL) { \
+            if (::MulticastLib::logEnabled(level)) {                        \
+                static ::MulticastLib::detail::LogSite site;                \
+                ::MulticastLib::detail::write(level, site, __VA_ARGS__);    \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+#define MULTICAST_LOG_TRACE(...) MULTICAST_LOG(::MulticastLib::LogLevel::Trace, __VA_ARGS__)
+#define MULTICAST_LOG_DEBUG(...) MULTICAST_LOG(::MulticastLib::LogLevel::Debug, __VA_ARGS__)
+#define MULTICAST_LOG_INFO(...) MULTICAST_LOG(::MulticastLib::LogLevel::Info, __VA_ARGS__)
+#define MULTICAST_LOG_WARNING(...) MULTICAST_LOG(::MulticastLib::LogLevel::Warning, __VA_ARGS__)
+#define MULTICAST_LOG_ERROR(...) MULTICAST_LOG(::MulticastLib::LogLevel::Error, __VA_ARGS__)
+
+#endif  // LOGGING_H
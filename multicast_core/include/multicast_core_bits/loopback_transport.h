@@ -0,0 +1,121 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_queue.h"
+#include "protocol.h"
+#include "transport.h"
+
+namespace MulticastLib {
+
+struct LoopbackConfig {
+    // MTU канала: датаграммы длиннее mtu - IPV4_UDP_OVERHEAD отбрасываются
+    int mtu = DEFAULT_MTU;
+    // Датаграмм в пути: общий пул буферов и очередь каждого приёмника. Если приёмник не
+    // успевает, датаграммы теряются, как при переполнении буфера сокета
+    int capacity = 4096;
+    // Искажения применяются у каждого приёмника независимо
+    double lossRatio = 0.0;
+    double duplicateRatio = 0.0;
+    // Доля датаграмм, задержанных ещё на reorderDelayUs: их обгоняют следующие
+    double reorderRatio = 0.0;
+    int reorderDelayUs = 1000;
+    // Задержка доставки: delayUs плюс равномерно распределённая от 0 до jitterUs
+    int delayUs = 0;
+    int jitterUs = 0;
+    // Зерно генератора искажений; у i-го приёмника - seed + i
+    uint64_t seed = 1;
+};
+
+struct LoopbackStatistics {
+    uint64_t packetsSent = 0;
+    uint64_t packetsDelivered = 0;
+    // Выброшены искажением потерь, не поместились в пул или очередь приёмника,
+    // длиннее MTU
+    uint64_t packetsLost = 0;
+    uint64_t packetsOverflowed = 0;
+    uint64_t packetsOversized = 0;
+    uint64_t packetsDuplicated = 0;
+    uint64_t controlMessages = 0;
+};
+
+// Сеть внутри процесса: один Sender и сколько угодно Receiver'ов без сокетов и
+// системных вызовов. Датаграмма копируется в буфер пула один раз и раздаётся всем
+// приёмникам по указателю через lock-free очереди; искажения (потери, дубли,
+// перестановки, джиттер) детерминированы зерном. Сеть создаётся через make_shared,
+// транспорты держат её, пока живы
+class LoopbackNetwork : public std::enable_shared_from_this<LoopbackNetwork> {
+   public:
+    explicit LoopbackNetwork(const LoopbackConfig& config = LoopbackConfig());
+    ~LoopbackNetwork();
+
+    LoopbackNetwork(const LoopbackNetwork&) = delete;
+    LoopbackNetwork& operator=(const LoopbackNetwork&) = delete;
+
+    std::unique_ptr<SenderTransport> createSenderTransport();
+    std::unique_ptr<ReceiverTransport> createReceiverTransport();
+    LoopbackStatistics getStatistics() const;
+
+   private:
+    friend class LoopbackSenderTransport;
+    friend class LoopbackReceiverTransport;
+
+    struct Packet {
+        // Очередей и отложенных доставок, которые ещё ссылаются на буфер
+        std::atomic<int> refs{0};
+        size_t len = 0;
+        std::chrono::steady_clock::time_point sentAt;
+        uint8_t* data = nullptr;
+    };
+
+    // Очередь одного приёмника; живёт, пока на неё ссылается хоть один снимок списка
+    struct Endpoint {
+        explicit Endpoint(LoopbackNetwork* network, size_t capacity);
+        ~Endpoint();
+
+        LoopbackNetwork* network;
+        FrameQueue<Packet*> queue;
+    };
+
+    using EndpointList = std::vector<std::shared_ptr<Endpoint>>;
+
+    std::shared_ptr<const EndpointList> endpoints() const;
+    void join(const std::shared_ptr<Endpoint>& endpoint);
+    void leave(const std::shared_ptr<Endpoint>& endpoint);
+    void release(Packet* packet);
+
+    LoopbackConfig config_;
+    size_t slotSize_;
+    std::vector<uint8_t> storage_;
+    std::unique_ptr<Packet[]> packets_;
+    FrameQueue<Packet*> freePackets_;
+
+    // Список приёмников меняется под мьютексом, отправитель читает снимок без блокировок
+    std::mutex endpointsMutex_;
+    std::shared_ptr<const EndpointList> endpoints_;
+    // Номер следующего приёмника, для его зерна
+    std::atomic<uint64_t> nextEndpointIndex_{0};
+
+    // Управляющие сообщения приёмников единственному Sender'у
+    FrameQueue<std::string> control_;
+    std::atomic<bool> senderOpen_{false};
+
+    std::atomic<uint64_t> packetsSent_{0};
+    std::atomic<uint64_t> packetsDelivered_{0};
+    std::atomic<uint64_t> packetsLost_{0};
+    std::atomic<uint64_t> packetsOverflowed_{0};
+    std::atomic<uint64_t> packetsOversized_{0};
+    std::atomic<uint64_t> packetsDuplicated_{0};
+    std::atomic<uint64_t> controlMessages_{0};
+};
+
+}  // namespace MulticastLib
+
+#endif  // LOOPBACK_TRANSPORT_H
@@ -0,0 +1,122 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MulticastLib {
+
+// Версия формата пакетов; пакеты другой версии приёмник отбрасывает
+constexpr uint8_t PROTOCOL_VERSION = 2;
+
+// Размер чанка выводится из MTU пути: MTU - заголовки IPv4 и UDP - заголовок чанка.
+// Jumbo-кадры (MTU до 9000) поддерживаются, если их пропускает сеть
+constexpr size_t IPV4_UDP_OVERHEAD = 20 + 8;
+constexpr size_t MIN_MTU = 576;
+constexpr size_t DEFAULT_MTU = 1500;
+constexpr size_t MAX_MTU = 9000;
+
+// Управляющий порт Sender'а (heartbeat'ы и NACK'и от клиентов)
+constexpr int CONTROL_PORT = 5050;
+
+// Присутствие клиента и обратная связь: HEARTBEAT:<clientID>[:<loss ratio>:<fps>]
+#define HEARTBEAT_PREFIX "HEARTBEAT:"
+
+// Запрос перепосылки: NACK:<clientID>:<frame_seq>:<from>-<to>,<from>-<to>,...
+// Диапазоны включительные, одиночный чанк можно передать без "-<to>"
+#define NACK_PREFIX "NACK:"
+constexpr size_t MAX_NACK_RANGES = 32;
+
+// Флаги пакета
+constexpr uint8_t CHUNK_FLAG_PARITY = 0x01;      // XOR-чётность группы, chunk_index - номер группы
+constexpr uint8_t CHUNK_FLAG_RETRANSMIT = 0x02;  // перепосылка по NACK
+// Флаги кадра, одинаковые у всех его пакетов
+constexpr uint8_t CHUNK_FLAG_SEGMENTED = 0x04;  // кадр - контейнер JPEG-сегментов
+constexpr uint8_t CHUNK_FLAG_DELTA = 0x08;      // сегменты обновляют часть предыдущего кадра
+constexpr uint8_t CHUNK_FLAG_ALIGNED = 0x10;    // каждый сегмент начинается с границы чанка
+constexpr uint8_t CHUNK_FRAME_FLAGS =
+    CHUNK_FLAG_SEGMENTED | CHUNK_FLAG_DELTA | CHUNK_FLAG_ALIGNED;
+constexpr uint8_t CHUNK_FLAGS_KNOWN =
+    CHUNK_FLAG_PARITY | CHUNK_FLAG_RETRANSMIT | CHUNK_FRAME_FLAGS;
+
+// Заголовок чанка кадра, все многобайтовые поля в сетевом порядке байт.
+// Полезная нагрузка начинается с header_len: новые поля добавляются в конец заголовка,
+// и приёмник, знающий только эту версию, их пропускает
+struct ChunkHeader {
+    uint8_t version;
+    uint8_t header_len;
+    uint8_t flags;
+    uint8_t fec_group;         // чанков данных в группе FEC, 0 - без FEC
+    uint32_t frame_seq;        // монотонный номер кадра
+    uint64_t capture_ts_us;    // время захвата кадра, мкс от эпохи system_clock
+    uint32_t frame_size;       // размер кадра в байтах
+    uint32_t payload_offset;   // смещение полезной нагрузки: chunk_index * chunk_size
+    uint16_t payload_len;      // длина полезной нагрузки этого пакета
+    uint16_t chunk_index;      // номер чанка, у пакета чётности - номер группы
+    uint16_t total_chunks;     // чанков данных в кадре
+    uint16_t chunk_size;       // размер всех чанков кадра, кроме последнего
+    // Расширение: задержки по часам Sender'а от захвата кадра, мкс. Приёмник принимает и
+    // заголовки без него (header_len = CHUNK_HEADER_MIN_LEN), задержки тогда нулевые
+    uint32_t encode_delay_us;  // захват -> конец кодирования
+    uint32_t send_delay_us;    // захват -> начало отправки
+};
+
+static_assert(sizeof(ChunkHeader) == 40, "ChunkHeader must match the wire format");
+
+// Длина заголовка без расширений
+constexpr size_t CHUNK_HEADER_MIN_LEN = 32;
+
+// Сегмент кадра с CHUNK_FLAG_SEGMENTED: прямоугольник кадра и длина JPEG, который идёт
+// сразу за заголовком. Сегменты следуют друг за другом до конца кадра; с
+// CHUNK_FLAG_ALIGNED следующий сегмент начинается с ближайшей границы чанка, и
+// потеря чанка портит только сегменты, которые его занимают
+struct SegmentHeader {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t frame_width;
+    uint16_t frame_height;
+    uint32_t jpeg_size;
+};
+
+static_assert(sizeof(SegmentHeader) == 16, "SegmentHeader must match the wire format");
+
+// Границы размера чанка: снизу - чтобы битовые маски сборщика были ограничены
+constexpr size_t MIN_CHUNK_SIZE = 256;
+constexpr size_t MAX_CHUNK_SIZE = MAX_MTU - IPV4_UDP_OVERHEAD - sizeof(ChunkHeader);
+constexpr size_t MAX_DATA_CHUNKS = 0xffff;
+
+constexpr size_t chunkSizeForMtu(size_t mtu) {
+    return mtu - IPV4_UDP_OVERHEAD - sizeof(ChunkHeader);
+}
+
+// Заголовок чанка в порядке байт хоста, после проверки
+struct ChunkInfo {
+    uint8_t headerLen = 0;
+    uint8_t flags = 0;
+    uint8_t fecGroup = 0;
+    uint32_t frameSeq = 0;
+    uint64_t captureTimestampUs = 0;
+    uint32_t frameSize = 0;
+    uint16_t payloadLen = 0;
+    uint16_t chunkIndex = 0;
+    uint16_t totalChunks = 0;
+    uint16_t chunkSize = 0;
+    uint32_t encodeDelayUs = 0;
+    uint32_t sendDelayUs = 0;
+};
+
+// Разбирает и проверяет заголовок датаграммы длины len. Все проверки выполняются
+// целиком, без ранних выходов, поэтому время не зависит от того, какое поле битое
+bool parseChunkHeader(const uint8_t* packet, size_t len, ChunkInfo* info);
+
+// Дописывает сегмент в контейнер кадра: SegmentHeader и jpegSize байт JPEG.
+// Поля header - в порядке байт хоста, jpeg_size заполняется здесь
+void appendSegment(std::vector<uint8_t>& out, SegmentHeader header, const uint8_t* jpeg,
+                   size_t jpegSize);
+
+}  // namespace MulticastLib
+
+#endif  // PROTOCOL_H
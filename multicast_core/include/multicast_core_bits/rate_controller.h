@@ -0,0 +1,45 @@
+#ifndef RATE_CONTROLLER_H
+#define RATE_CONTROLLER_H
+
+namespace MulticastLib {
+
+// Текущая рабочая точка кодера и то, по чему она выбрана
+struct OperatingPoint {
+    int jpegQuality = 80;
+    double scale = 1.0;
+    double fps = 30.0;
+    int targetBitrateKbps = 0;
+    double measuredBitrateKbps = 0.0;
+    double worstLossRatio = 0.0;
+};
+
+// Регулятор битрейта по обратной связи от клиентов. Раз в интервал получает
+// измеренный битрейт и худшие потери среди клиентов и сдвигает рабочую точку:
+// при потерях или превышении цели сначала снижается качество JPEG, затем
+// разрешение, затем частота кадров; при запасе - восстанавливается в обратном порядке.
+class RateController {
+   public:
+    RateController(int targetBitrateKbps, double lossThreshold, int maxQuality, double maxFps);
+
+    const OperatingPoint& update(double measuredBitrateKbps, double worstLossRatio);
+    const OperatingPoint& current() const { return point_; }
+
+    // 0 выключает адаптацию и возвращает рабочую точку к максимуму
+    void setTargetBitrate(int kbps);
+    bool enabled() const { return point_.targetBitrateKbps > 0; }
+
+   private:
+    void stepDown(int qualityStep);
+    void stepUp();
+    void reset();
+
+    OperatingPoint point_;
+    double lossThreshold_;
+    int maxQuality_;
+    double maxFps_;
+    int scaleIndex_ = 0;
+};
+
+}  // namespace MulticastLib
+
+#endif  // RATE_CONTROLLER_H
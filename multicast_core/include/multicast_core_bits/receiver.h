@@ -2,67 +2,295 @@
 #define RECEIVER_H
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include "frame_assembler.h"
+#include "frame_queue.h"
+#include "jpeg_codec.h"
+#include "latency_histogram.h"
+#include "protocol.h"
+#include "transport.h"
+#include "video_frame.h"
+#include "worker_pool.h"
 
 namespace MulticastLib {
 
 struct ReceiverStatistics {
     uint64_t totalPacketsReceived = 0;
+    // Системные вызовы приёма датаграмм
+    uint64_t totalReceiveSyscalls = 0;
     uint64_t totalCorruptedPackets = 0;
     uint64_t totalFramesDecoded = 0;
+    // Кадры, опубликованные как есть, без декодирования (decodeFrames = false)
+    uint64_t totalFramesPassedThrough = 0;
+    // Кадры, не собранные до таймаута или вытесненные более новыми
+    uint64_t totalFramesDropped = 0;
+    // Кадры, декодированные позже уже опубликованного более нового кадра
+    uint64_t totalStaleFrames = 0;
+    // Чанки, восстановленные по FEC без перепосылки
+    uint64_t totalRecoveredChunks = 0;
+    uint64_t totalNacksSent = 0;
+    // Кадры, опубликованные без части чанков (decodePartialFrames)
+    uint64_t totalPartialFrames = 0;
+    // Доля чанков кадра, дошедших до декодера: у последнего кадра и в среднем
+    double lastFrameCompleteness = 1.0;
+    double avgFrameCompleteness = 1.0;
     double avgFps = 0.0;
+    // FPS за последнюю секунду и джиттер интервалов между кадрами
+    double windowFps = 0.0;
+    double jitterMs = 0.0;
+    size_t decodeQueueDepth = 0;
+    double lastDecodeTimeMs = 0.0;
+    double avgDecodeTimeMs = 0.0;
     std::chrono::steady_clock::time_point lastFrameTime = std::chrono::steady_clock::now();
+    // Задержки по стадиям: захват -> конец кодирования и захват -> отправка (по часам
+    // Sender'а), первый -> последний пакет кадра, декодирование, публикация кадра ->
+    // его первое чтение через getLatestFrame / getLatestFrameHandle
+    LatencySummary captureToEncodeLatency;
+    LatencySummary captureToSendLatency;
+    LatencySummary reassemblyLatency;
+    LatencySummary decodeLatency;
+    LatencySummary pickupLatency;
+};
+
+struct ReceiverConfig {
+    // Максимум датаграмм, забираемых одним вызовом recvmmsg
+    int recvBatchSize = 32;
+    // Размер слота кольца приёма; датаграммы длиннее считаются битыми
+    int packetSlotSize = 9216;
+    // SO_RCVBUF сокета в байтах, 0 - оставить системное значение
+    int socketRecvBufferSize = 4 * 1024 * 1024;
+    // Приём через recvmmsg или io_uring (multishot recvmsg в кольцо буферов, без копии
+    // датаграмм); без поддержки io_uring - всегда recvmmsg
+    IoBackend ioBackend = IoBackend::Sockets;
+    // UDP GRO: ядро (5.0+) отдаёт датаграммы потока склеенными, транспорт режет их обратно
+    // прямо на вход сборщика кадров. Только с ioBackend = Sockets
+    bool receiveOffload = false;
+    // Число одновременно собираемых кадров и максимальный размер кадра в байтах
+    int frameSlotCount = 8;
+    int maxFrameSize = 2 * 1024 * 1024;
+    // Потоки декодирования JPEG и ёмкость очереди собранных кадров перед ними
+    int decodeThreads = 2;
+    int decodeQueueCapacity = 4;
+    // Сегменты одного кадра (полосы, тайлы) декодируются параллельно на стольких
+    // исполнителях, считая сам поток декодирования: всего до decodeThreads *
+    // segmentDecodeThreads потоков. 1 - сегменты декодируются по очереди
+    int segmentDecodeThreads = 2;
+    // Heartbeat'ы (присутствие и обратная связь для регулятора битрейта Sender'а) идут
+    // не чаще раза в heartbeatIntervalMs; Sender забывает клиента после 3 с тишины
+    int heartbeatIntervalMs = 500;
+    // NACK: запрашивать у Sender'а перепосылку чанков кадра, если в него nackDelayMs
+    // ничего не приходило; повтор через nackRetryMs, не больше maxNackRetries раз
+    bool enableNack = true;
+    int nackDelayMs = 5;
+    int nackRetryMs = 15;
+    int maxNackRetries = 3;
+    // Кадр с сегментами по границам чанков (SenderConfig::alignStripsToChunks), в который
+    // partialFrameDelayMs не приходили чанки, декодируется без недостающих сегментов;
+    // на их месте остаётся предыдущий кадр
+    bool decodePartialFrames = true;
+    int partialFrameDelayMs = 30;
+    // Отдавать кадры из getLatestFrame в I420 (CV_8UC1, высота * 3 / 2 строк), без
+    // преобразования в BGR. Сегментированные кадры всегда собираются в BGR
+    bool decodeToYuv = false;
+    // Декодировать цельные кадры. Без декодирования кадры доступны только как JPEG
+    // (getLatestEncodedFrame, waitForEncodedFrame) - например, для раздачи MJPEG по
+    // HTTP. Сегментированные кадры декодируются всегда: цельного JPEG у них нет
+    bool decodeFrames = true;
 };
 
+// Обработчик нового кадра. Вызывается из потока доставки Receiver'а по разу на кадр в
+// порядке номеров; пока обработчик работает, более новые кадры могут быть пропущены
+using FrameCallback = std::function<void(const FrameHandle& frame)>;
+
 class Receiver {
    public:
     Receiver(const std::string& multicastAddress, int port);
+    Receiver(const std::string& multicastAddress, int port, const ReceiverConfig& config);
     ~Receiver();
 
     bool start();
     void stop();
+    // Копия последнего кадра; пустая матрица, если кадров ещё не было
     cv::Mat getLatestFrame();
+    // Последний кадр без копии: неизменяемый, живёт, пока жив handle. nullptr, если
+    // кадров ещё не было. Не блокирует потоки декодирования
+    FrameHandle getLatestFrameHandle();
+    // Ждёт кадр новее lastSequence (0 - любой) не дольше timeout. nullptr - таймаут или
+    // приём остановлен. Промежуточные кадры, не забранные вовремя, пропускаются:
+    // возвращается всегда самый новый
+    FrameHandle waitForFrame(uint64_t lastSequence, std::chrono::milliseconds timeout);
+    // Обработчики новых кадров, id - для removeFrameCallback. После возврата из
+    // removeFrameCallback обработчик больше не вызывается. Обработчики вызываются без
+    // блокировок, из них можно добавлять и удалять обработчики (в том числе себя)
+    size_t addFrameCallback(FrameCallback callback);
+    void removeFrameCallback(size_t id);
+
+    // Последний цельный кадр в том виде, в каком пришёл: JPEG без декодирования и
+    // перекодирования, с тем же номером, что и декодированный кадр. Сегментированные
+    // кадры (тайлы, полосы) сюда не попадают. Ожидание - как у waitForFrame
+    EncodedFrameHandle getLatestEncodedFrame();
+    EncodedFrameHandle waitForEncodedFrame(uint64_t lastSequence,
+                                           std::chrono::milliseconds timeout);
+    // Включение декодирования на ходу (см. ReceiverConfig::decodeFrames)
+    void setDecodeEnabled(bool enabled);
+    // Заменяет UDP multicast другим транспортом (например, LoopbackNetwork); только
+    // пока приём остановлен
+    bool setTransport(std::unique_ptr<ReceiverTransport> transport);
     bool isReceiving();
     ReceiverStatistics getStatistics();
 
    private:
-    struct FrameData {
-        std::unordered_map<uint16_t, std::vector<uint8_t>> chunks;
-        uint16_t expected_chunks;
-        std::chrono::steady_clock::time_point timestamp;
+    // multicast_core_bench меряет сборку кадра из пакетов без потоков и сети
+    friend struct BenchAccess;
+
+    // Сегмент кадра (тайл или полоса): JPEG в буфере слота и результат декодирования
+    struct DecodedSegment {
+        cv::Rect rect;
+        const uint8_t* jpeg = nullptr;
+        size_t jpegSize = 0;
+        bool decoded = false;
+        cv::Mat image;
+    };
+
+    // Декодеры потока декодирования, по одному на исполнителя пула сегментов
+    struct SegmentDecoders {
+        explicit SegmentDecoders(int threadCount);
+
+        WorkerPool pool;
+        std::vector<std::unique_ptr<JpegDecoder>> decoders;
     };
 
     bool receiveLoop();
-    bool setupSocket();
-    void processPacket(const std::vector<uint8_t>& buffer, ssize_t recvLen);
+    void decodeLoop();
+    void callbackLoop();
+    bool openTransport();
+    // false - датаграмма битая или не подходит к собираемому кадру
+    bool processPacket(const uint8_t* data, size_t len);
+    void enqueueForDecode(const CompletedFrame& frame);
+    size_t decodeSegments(SegmentDecoders& decoders, const CompletedFrame& frame,
+                          std::vector<DecodedSegment>& segments, cv::Size& frameSize);
+    void publishFrame(cv::Mat& frame, uint64_t sequence, uint64_t captureTimestampUs,
+                      double decodeTimeMs);
+    void publishSegments(const std::vector<DecodedSegment>& segments, size_t count,
+                         const cv::Size& frameSize, uint64_t sequence,
+                         uint64_t captureTimestampUs, double decodeTimeMs, double completeness);
+    void updateDecodeStatistics(double decodeTimeMs, double completeness);
+    void publishEncoded(std::shared_ptr<EncodedVideoFrame> frame);
+    void updatePassthroughStatistics();
+    void updateFrameRate(std::chrono::steady_clock::time_point now);
+    template <typename Frame>
+    std::shared_ptr<const Frame> waitForPublished(const LatestFrame<Frame>& latest,
+                                                  uint64_t lastSequence,
+                                                  std::chrono::milliseconds timeout);
+    void notifyFrameWaiters();
+    void recordPickup(uint64_t sequence, std::chrono::steady_clock::time_point publishTime);
     void cleanupExpiredFrames();
-    bool sendHeartbeat(const sockaddr_in& senderAddr);
+    bool sendHeartbeat();
+    void sendNacks();
+    void collectPartialFrames();
+    void updateFeedbackWindow();
     std::string generateClientID();
 
     std::string multicastIP_;
     int port_;
-    int sockfd_;
-    int data_received;
-    struct sockaddr_in localAddr_;
-    struct ip_mreq mreq_;
+    ReceiverConfig config_;
+    std::unique_ptr<ReceiverTransport> transport_;
+    // Датаграммы уже приходили: транспорт знает, куда слать heartbeat'ы и NACK'и
+    bool hasSenderAddr_ = false;
+    std::chrono::steady_clock::time_point lastHeartbeatTime_;
 
     std::atomic<bool> isReceiving_;
     std::thread receiveThread_;
 
-    std::unordered_map<std::string, FrameData> frames_;
-    std::mutex framesMutex_;
+    // Кольцо приёма: непрерывный буфер из recvBatchSize слотов фиксированного размера
+    std::vector<uint8_t> rxRing_;
+    std::vector<struct iovec> rxIovecs_;
+    std::vector<struct mmsghdr> rxMessages_;
+
+    // Собирается только потоком приёма, слоты освобождают потоки декодирования
+    FrameAssembler assembler_;
+    std::atomic<uint64_t> recoveredChunks_{0};
+    // Пишет только поток приёма, раз на пачку датаграмм; статистика читает без блокировок
+    std::atomic<uint64_t> packetsReceived_{0};
+    std::atomic<uint64_t> corruptedPackets_{0};
+
+    // Окно обратной связи для Sender'а, ведётся потоком приёма
+    uint64_t framesCompleted_ = 0;
+    uint64_t framesPartial_ = 0;
+    uint64_t feedbackCompleted_ = 0;
+    uint64_t feedbackDropped_ = 0;
+    uint64_t feedbackPartial_ = 0;
+    std::chrono::steady_clock::time_point feedbackWindowStart_ = std::chrono::steady_clock::now();
+    double feedbackLossRatio_ = 0.0;
+    double feedbackFps_ = 0.0;
 
-    cv::Mat lastFrame_;
+    FrameQueue<CompletedFrame> decodeQueue_;
+    std::vector<std::thread> decodeThreads_;
+
+    // Последний кадр читается без frameMutex_ (см. LatestFrame); публикуют его потоки
+    // декодирования под frameMutex_, беря кадры из пула, чтобы не выделять память под
+    // каждое изображение
+    LatestFrame<VideoFrame> latestFrame_;
+    FramePool<VideoFrame> framePool_;
+    // То же для принятых JPEG; номер последнего опубликованного защищён frameMutex_
+    LatestFrame<EncodedVideoFrame> latestEncodedFrame_;
+    FramePool<EncodedVideoFrame> encodedFramePool_;
+    uint64_t lastEncodedSequence_ = 0;
+    std::atomic<bool> decodeEnabled_;
+    uint64_t lastFrameSequence_ = 0;
+    bool hasFrame_ = false;
+    // Последний кадр, чьё время публикации уже учтено в pickupLatency
+    std::atomic<uint64_t> pickedUpSequence_{0};
+    // Холст для сегментированных кадров и номер кадра, из которого взят каждый сегмент
+    // (ключ - x << 16 | y). canvasPublished_ - последним опубликован кадр из холста,
+    // а не цельный. Защищены frameMutex_
+    cv::Mat canvas_;
+    bool canvasPublished_ = false;
+    std::unordered_map<uint32_t, uint64_t> segmentSequence_;
     std::mutex frameMutex_;
+    // waitForFrame будится при каждой публикации кадра и при остановке приёма
+    std::mutex frameWaitMutex_;
+    std::condition_variable frameCv_;
+
+    // Обработчики кадров и поток, который их вызывает. Обработчики вызываются по снимку
+    // списка вне мьютекса; callbacksRunning_ - идёт проход по снимку, его конца ждёт
+    // removeFrameCallback
+    std::map<size_t, std::shared_ptr<FrameCallback>> frameCallbacks_;
+    size_t nextCallbackId_ = 1;
+    std::mutex callbacksMutex_;
+    std::condition_variable callbacksCv_;
+    bool callbacksRunning_ = false;
+    std::thread callbackThread_;
 
     ReceiverStatistics stats_;
     std::mutex statsMutex_;
+    // Окно для windowFps и последний интервал между кадрами, защищены statsMutex_
+    std::deque<std::chrono::steady_clock::time_point> frameTimes_;
+    double lastFrameIntervalMs_ = 0.0;
+    // Кадры, по которым считаются avgFps и джиттер: декодированные и пропущенные как есть
+    uint64_t framesDelivered_ = 0;
+
+    // Гистограммы пишутся без блокировок потоками приёма, декодирования и читателями кадров
+    LatencyHistogram captureToEncodeLatency_;
+    LatencyHistogram captureToSendLatency_;
+    LatencyHistogram reassemblyLatency_;
+    LatencyHistogram decodeLatency_;
+    LatencyHistogram pickupLatency_;
 
     std::string receiverID_;
 };
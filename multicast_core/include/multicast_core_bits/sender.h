@@ -2,53 +2,336 @@
 #define SENDER_H
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 
 #include <atomic>
 #include <chrono>
-#include <map>
 #include <mutex>
+#include <memory>
 #include <opencv2/opencv.hpp>
+#include <string_view>
 #include <thread>
+#include <vector>
+
+#include "client_registry.h"
+#include "frame_queue.h"
+#include "frame_source.h"
+#include "jpeg_codec.h"
+#include "latency_histogram.h"
+#include "protocol.h"
+#include "rate_controller.h"
+#include "strip_encoder.h"
+#include "tile_delta.h"
+#include "transport.h"
+#include "video_frame.h"
 
 namespace MulticastLib {
 
+struct TransmitStatistics {
+    uint64_t totalFramesSent = 0;
+    uint64_t totalPacketsSent = 0;
+    uint64_t totalBytesSent = 0;
+    uint64_t totalSyscalls = 0;
+    uint64_t totalSendErrors = 0;
+    uint64_t totalNacksReceived = 0;
+    uint64_t totalRetransmittedPackets = 0;
+    // Запросы чанков, подавленные, потому что чанк только что уже перепосылался
+    uint64_t totalSuppressedRetransmits = 0;
+};
+
+struct SenderConfig {
+    // Откуда берутся кадры: камера, видеофайл, файл несжатых кадров или тестовый сигнал.
+    // Любой источник идёт в темпе targetFps
+    FrameSourceConfig source;
+    // Целевая частота кадров; захват выравнивается по абсолютным дедлайнам
+    double targetFps = 30.0;
+    // Ёмкость очередей capture -> encode и encode -> transmit
+    int queueCapacity = 4;
+    // При переполнении очереди выбрасывать самый старый кадр, иначе ждать стадию-потребителя
+    bool dropOldest = true;
+    // MTU пути: размер чанка = mtu - заголовки IPv4/UDP - заголовок чанка. В сети с
+    // jumbo-кадрами можно поднять до MAX_MTU; приёмнику нужен packetSlotSize не меньше
+    int mtu = DEFAULT_MTU;
+    // Отправка через sendmmsg или io_uring; без поддержки io_uring - всегда sendmmsg
+    IoBackend ioBackend = IoBackend::Sockets;
+    // UDP GSO (UDP_SEGMENT): чанки пачки уходят в ядро несколькими большими буферами,
+    // на датаграммы их режет ядро или сетевая карта. Без поддержки ядром (4.18+) или
+    // интерфейсом - отправка по одной датаграмме
+    bool segmentationOffload = false;
+    // FEC: один пакет XOR-чётности на fecGroupSize чанков данных (избыточность 1/N),
+    // 0 - без FEC. Приёмник восстанавливает один потерянный чанк в каждой группе
+    int fecGroupSize = 0;
+    // NACK: сколько последних кадров хранится для перепосылки чанков
+    int retransmitFrames = 8;
+    // Повторный NACK на тот же чанк раньше этого окна игнорируется (много клиентов
+    // обычно теряют один и тот же пакет - перепосылаем его один раз)
+    int nackSuppressionMs = 10;
+    // Начальное (и максимальное при адаптации) качество JPEG
+    int jpegQuality = 80;
+    // Адаптация битрейта по обратной связи клиентов: целевой битрейт, 0 - выключена
+    int targetBitrateKbps = 0;
+    // Доля потерянных кадров у худшего клиента, выше которой битрейт снижается
+    double maxLossRatio = 0.05;
+    // Дельта-режим для почти статичных сцен: кадр делится на тайлы tileSize x tileSize,
+    // отправляются только тайлы, изменившиеся в среднем больше чем на tileChangeThreshold
+    // на байт; раз в tileRefreshInterval кадров - все тайлы. 0 - режим выключен
+    int tileSize = 0;
+    double tileChangeThreshold = 2.0;
+    int tileRefreshInterval = 30;
+    // Параллельное кодирование для 1080p/4K: кадр делится на stripCount горизонтальных
+    // полос, каждая сжимается отдельным JPEG на stripThreads потоках (0 - по числу ядер).
+    // stripCount < 2 - кадр кодируется целиком; дельта-режим тайлов имеет приоритет
+    int stripCount = 0;
+    int stripThreads = 0;
+    // Полосы начинаются с границ чанков: при потере пакета приёмник декодирует кадр
+    // без испорченных полос и скрывает их предыдущим кадром (ReceiverConfig::
+    // decodePartialFrames). Цена - выравнивание, в среднем полчанка на полосу
+    bool alignStripsToChunks = true;
+};
+
+struct PipelineStatistics {
+    size_t captureQueueDepth = 0;
+    size_t encodeQueueDepth = 0;
+    uint64_t totalFramesCaptured = 0;
+    uint64_t totalFramesDropped = 0;
+    // Дельта-режим: отправленные и пропущенные как неизменившиеся тайлы
+    uint64_t totalTilesSent = 0;
+    uint64_t totalTilesSkipped = 0;
+};
+
+// Сводная статистика Sender'а: счётчики всех стадий конвейера и времена стадий
+struct SenderStatistics {
+    uint64_t totalFramesCaptured = 0;
+    // Неудачные чтения камеры и отставания захвата от темпа больше чем на кадр
+    uint64_t totalCaptureFailures = 0;
+    uint64_t totalCaptureStalls = 0;
+    // Кадры, выброшенные из переполненных очередей
+    uint64_t totalFramesDropped = 0;
+    uint64_t totalFramesEncoded = 0;
+    uint64_t totalEncodeFailures = 0;
+    uint64_t totalFramesSent = 0;
+    uint64_t totalPacketsSent = 0;
+    uint64_t totalBytesSent = 0;
+    uint64_t totalSyscalls = 0;
+    uint64_t totalSendErrors = 0;
+    // sendmmsg вернул EAGAIN/ENOBUFS: переполнен буфер сокета или очередь интерфейса
+    uint64_t totalSendWouldBlock = 0;
+    uint64_t totalNacksReceived = 0;
+    uint64_t totalRetransmittedPackets = 0;
+    uint64_t totalSuppressedRetransmits = 0;
+    uint64_t totalTilesSent = 0;
+    uint64_t totalTilesSkipped = 0;
+    size_t captureQueueDepth = 0;
+    size_t encodeQueueDepth = 0;
+    int activeClients = 0;
+    // Отправленные кадры и битрейт за последнюю секунду
+    double windowFps = 0.0;
+    double bitrateKbps = 0.0;
+    // Размер закодированного кадра в байтах и пакетов данных на кадр
+    size_t lastFrameSize = 0;
+    double avgFrameSize = 0.0;
+    double avgPacketsPerFrame = 0.0;
+    // Времена стадий: чтение кадра из источника, кодирование, отправка пакетов кадра,
+    // захват -> начало отправки
+    LatencySummary captureLatency;
+    LatencySummary encodeLatency;
+    LatencySummary transmitLatency;
+    LatencySummary captureToSendLatency;
+};
+
 class Sender {
    public:
     Sender(const std::string& multicastAddress, int port);
+    Sender(const std::string& multicastAddress, int port, const SenderConfig& config);
     ~Sender();
 
     bool startStream();
     void stopStream();
 
+    // Заменяет источник из SenderConfig::source; только пока стрим остановлен
+    bool setFrameSource(std::unique_ptr<FrameSource> source);
+    // Заменяет UDP multicast другим транспортом (например, LoopbackNetwork); только
+    // пока стрим остановлен
+    bool setTransport(std::unique_ptr<SenderTransport> transport);
+
+    // Копия последнего захваченного кадра и он же без копии (nullptr до первого кадра)
     cv::Mat getPreviewFrame();
+    FrameHandle getPreviewFrameHandle() const;
 
     int getActiveClientCount() const;
+    TransmitStatistics getTransmitStatistics() const;
+    PipelineStatistics getPipelineStatistics() const;
+    SenderStatistics getStatistics() const;
+
+    OperatingPoint getOperatingPoint();
+    void setTargetBitrate(int kbps);
 
    private:
-    void streamLoop();
-    bool setupSocket();
-    void sendFrameToMulticast(const cv::Mat& frame);
+    // multicast_core_bench меряет нарезку кадра на чанки без потоков и сети
+    friend struct BenchAccess;
+
+    struct CapturedFrame {
+        cv::Mat image;
+        std::chrono::steady_clock::time_point captureTime;
+        uint64_t captureTimestampUs = 0;
+    };
+
+    struct EncodedFrame {
+        std::shared_ptr<std::vector<uchar>> data;
+        std::chrono::steady_clock::time_point captureTime;
+        uint64_t captureTimestampUs = 0;
+        uint32_t encodeDelayUs = 0;
+        uint8_t flags = 0;
+    };
+
+    // Поля заголовка, общие для всех чанков кадра
+    struct FrameMeta {
+        uint32_t frameSeq = 0;
+        uint64_t captureTimestampUs = 0;
+        uint32_t frameSize = 0;
+        uint16_t totalChunks = 0;
+        uint16_t chunkSize = 0;
+        uint8_t fecGroup = 0;
+        uint8_t flags = 0;
+        uint32_t encodeDelayUs = 0;
+        uint32_t sendDelayUs = 0;
+    };
+
+    // Пачка датаграмм для sendmmsg; буферы переиспользуются между кадрами
+    struct TxBatch {
+        std::vector<ChunkHeader> headers;
+        std::vector<struct iovec> iovecs;
+        std::vector<struct mmsghdr> messages;
+        size_t count = 0;
+    };
+
+    // Счётчики, которые пишет один поток: инкремент - load + store без атомарной
+    // RMW-инструкции, читатели статистики обходятся без блокировок. Каждый набор на
+    // своей кэш-линии, чтобы стадии не делили её между собой
+    struct alignas(64) CaptureCounters {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> stalls{0};
+    };
+
+    struct alignas(64) EncodeCounters {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> lastFrameSize{0};
+    };
+
+    // Поток transmit и поток control (перепосылка) ведут по своему набору
+    struct alignas(64) SendCounters {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> dataPackets{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> syscalls{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> wouldBlock{0};
+    };
+
+    // Недавно отправленный кадр, из которого перепосылаются чанки по NACK
+    struct RetransmitEntry {
+        FrameMeta frame;
+        std::shared_ptr<const std::vector<uchar>> data;
+        std::vector<std::chrono::steady_clock::time_point> lastResent;
+    };
+
+    void captureLoop();
+    void encodeLoop();
+    std::shared_ptr<std::vector<uchar>> acquireEncodeBuffer();
+    void transmitLoop();
+    void sendFrameToMulticast(const std::vector<uchar>& buffer, const FrameMeta& frame);
+    void resetBatch(TxBatch& batch, size_t capacity);
+    void addChunkMessage(TxBatch& batch, const FrameMeta& frame, uint8_t flags,
+                         uint16_t chunkIndex, const void* payload, size_t len);
+    uint64_t flushBatch(TxBatch& batch, SendCounters& counters);
+    void rememberFrame(const FrameMeta& frame, std::shared_ptr<const std::vector<uchar>> data);
+    void handleNack(std::string_view message);
+    // false - по пути потерян кадр: выброшен более старый или стрим остановлен
+    template <typename T>
+    bool pushToStage(FrameQueue<T>& queue, T&& item);
     void startControlListener();
-    void cleanupInactiveClients();
+    void controlLoop();
+    void handleHeartbeat(const char* message);
+    void updateRateControl();
+    // Переносит рабочую точку регулятора в кодер и захват; под rateMutex_
+    void applyOperatingPoint(const OperatingPoint& point);
 
     std::string multicastIP_;
     int port_;
-    int sockfd_;
-    struct sockaddr_in multicastAddr_;
+    SenderConfig config_;
+    std::unique_ptr<SenderTransport> transport_;
+    size_t chunkSize_;
+    // Номер следующего кадра; начальное значение случайно, чтобы приёмники различали сессии
+    uint32_t nextFrameSeq_;
 
-    cv::VideoCapture camera_;
+    // Буферы пакетной отправки потока transmit
+    TxBatch txBatch_;
+    std::vector<uint8_t> txParity_;
+
+    // Кольцо недавно отправленных кадров для NACK, кадр N лежит в ячейке N % размер.
+    // Перепосылка идёт из потока control
+    std::vector<RetransmitEntry> retransmitRing_;
+    std::mutex retransmitMutex_;
+    TxBatch retransmitBatch_;
+
+    SendCounters transmitCounters_;
+    SendCounters retransmitCounters_;
+    std::atomic<uint64_t> nacksReceived_{0};
+    std::atomic<uint64_t> retransmittedPackets_{0};
+    std::atomic<uint64_t> suppressedRetransmits_{0};
+
+    std::unique_ptr<FrameSource> source_;
     std::atomic<bool> isStreaming_;
-    std::thread streamThread_;
 
-    cv::Mat lastFrame_;
-    std::mutex lastFrameMutex_;
+    // Конвейер: захват -> кодирование -> отправка, каждая стадия в своём потоке
+    std::thread captureThread_;
+    std::thread encodeThread_;
+    std::thread transmitThread_;
+    FrameQueue<CapturedFrame> captureQueue_;
+    FrameQueue<EncodedFrame> encodeQueue_;
+    CaptureCounters captureCounters_;
+    EncodeCounters encodeCounters_;
+    // Выбрасывать кадры могут и захват, и кодирование
+    std::atomic<uint64_t> framesDropped_{0};
 
+    // Времена стадий, см. SenderStatistics
+    LatencyHistogram captureLatency_;
+    LatencyHistogram encodeLatency_;
+    LatencyHistogram transmitLatency_;
+    LatencyHistogram captureToSendLatency_;
+    // Кодеры стадии encode; дельта-кодер тайлов и кодер полос - только в своих режимах
+    JpegEncoder jpegEncoder_;
+    std::unique_ptr<TileDeltaEncoder> tileEncoder_;
+    std::unique_ptr<StripEncoder> stripEncoder_;
+    // Пул буферов JPEG: буфер возвращается в оборот, когда кадр отправлен и вытеснен
+    // из кольца перепосылки, поэтому в установившемся режиме память не выделяется
+    std::vector<std::shared_ptr<std::vector<uchar>>> encodeBuffers_;
+
+    // Последний захваченный кадр для превью, публикуется потоком захвата без блокировок
+    LatestFrame<VideoFrame> previewFrame_;
+
+    // Клиенты по heartbeat'ам: реестр ведёт только управляющий поток, он же удаляет
+    // замолчавших. Число клиентов и худшие потери читаются атомарно
     std::thread controlThread_;
-    std::mutex clientMutex_;
-    std::map<std::string, std::chrono::steady_clock::time_point> clientHeartbeats_;
-    std::atomic<int> activeClientCount_{0};
+    ClientRegistry clients_;
+
+    // Адаптация битрейта: регулятор обновляется своим потоком, стадии читают атомики
+    RateController rateController_;
+    std::mutex rateMutex_;
+    std::chrono::steady_clock::time_point rateWindowStart_;
+    uint64_t rateWindowBytes_ = 0;
+    uint64_t rateWindowFrames_ = 0;
+    std::atomic<double> windowFps_{0.0};
+    std::atomic<double> bitrateKbps_{0.0};
+    std::atomic<int> jpegQuality_;
+    std::atomic<double> frameScale_{1.0};
+    std::atomic<double> currentFps_;
 
-    std::thread cleanupThread_;
+    std::thread rateControlThread_;
 };
 
 }  // namespace MulticastLib
@@ -0,0 +1,45 @@
+#ifndef STRIP_ENCODER_H
+#define STRIP_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "jpeg_codec.h"
+#include "worker_pool.h"
+
+namespace MulticastLib {
+
+// Параллельное кодирование кадра горизонтальными полосами. Каждая полоса сжимается
+// своим исполнителем пула в отдельный JPEG и попадает в контейнер сегментов
+// (см. SegmentHeader) - приёмник декодирует полосы независимо и тоже параллельно.
+// Используется одним потоком
+class StripEncoder {
+   public:
+    // threadCount - исполнителей вместе с вызывающим потоком
+    StripEncoder(int stripCount, int threadCount);
+
+    // Кодирует кадр в контейнер сегментов и выставляет флаги кадра. alignment > 0 -
+    // размер чанка: каждая полоса начинается с его границы (CHUNK_FLAG_ALIGNED), и
+    // приёмник может декодировать кадр без части чанков
+    bool encode(const cv::Mat& frame, int quality, std::vector<uchar>& out, uint8_t* flags,
+                size_t alignment = 0);
+
+    size_t threadCount() const { return pool_.size(); }
+
+   private:
+    int stripCount_;
+    WorkerPool pool_;
+    // Кодер на каждого исполнителя пула
+    std::vector<std::unique_ptr<JpegEncoder>> encoders_;
+    // Полосы текущего кадра и их JPEG; буферы переиспользуются между кадрами
+    std::vector<cv::Rect> strips_;
+    std::vector<std::vector<uchar>> jpegs_;
+    std::vector<char> encoded_;
+};
+
+}  // namespace MulticastLib
+
+#endif  // STRIP_ENCODER_H
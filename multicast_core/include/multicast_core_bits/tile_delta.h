@@ -0,0 +1,64 @@
+#ifndef TILE_DELTA_H
+#define TILE_DELTA_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "jpeg_codec.h"
+
+namespace MulticastLib {
+
+// Сумма |a[i] - b[i]| по len байтам. Ядро выбирается при первом вызове по возможностям
+// CPU (AVX2 / SSE2 / NEON), иначе скалярный вариант.
+uint64_t sumAbsDiff(const uint8_t* a, const uint8_t* b, size_t len);
+
+// Дельта-кодирование кадра тайлами. Каждый тайл сравнивается с тем, что было отправлено
+// в прошлый раз; в кадр попадают только тайлы, изменившиеся в среднем больше чем на
+// changeThreshold на байт, каждый отдельным JPEG-сегментом (см. SegmentHeader).
+// Раз в refreshInterval кадров отправляются все тайлы - для новых и потерявших кадры
+// клиентов. Используется одним потоком; forceRefresh и счётчики - из любого.
+class TileDeltaEncoder {
+   public:
+    TileDeltaEncoder(int tileSize, double changeThreshold, int refreshInterval);
+
+    // Кодирует кадр в контейнер сегментов и выставляет флаги кадра. false - ни один тайл
+    // не изменился, отправлять нечего. Статичная сцена всё равно раз в полсекунды даёт
+    // пустой дельта-кадр, чтобы приёмники не сочли поток пропавшим
+    bool encode(const cv::Mat& frame, int quality, std::vector<uchar>& out, uint8_t* flags);
+
+    // Следующий кадр будет полным. Зовётся, если закодированный кадр не дошёл до сети:
+    // его тайлы уже учтены в reference_ и иначе не дойдут до следующего обновления
+    void forceRefresh() { refreshRequested_.store(true, std::memory_order_release); }
+
+    uint64_t tilesSent() const { return tilesSent_.load(std::memory_order_relaxed); }
+    uint64_t tilesSkipped() const { return tilesSkipped_.load(std::memory_order_relaxed); }
+
+   private:
+    bool tileChanged(const cv::Mat& frame, const cv::Rect& tile) const;
+    void appendSegment(std::vector<uchar>& out, const cv::Mat& frame, const cv::Rect& tile);
+
+    int tileSize_;
+    double changeThreshold_;
+    int refreshInterval_;
+    int framesSinceRefresh_;
+    std::atomic<bool> refreshRequested_{false};
+    // Когда encode в последний раз вернул кадр к отправке
+    std::chrono::steady_clock::time_point lastEmitted_;
+
+    // Содержимое тайлов на момент их последней отправки
+    cv::Mat reference_;
+    int quality_ = 80;
+    JpegEncoder jpegEncoder_;
+    std::vector<uchar> jpeg_;
+
+    std::atomic<uint64_t> tilesSent_{0};
+    std::atomic<uint64_t> tilesSkipped_{0};
+};
+
+}  // namespace MulticastLib
+
+#endif  // TILE_DELTA_H
@@ -0,0 +1,168 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MulticastLib {
+
+// Как UDP-транспорт ходит в ядро: sendmmsg/recvmmsg или io_uring. io_uring
+// используется, если библиотека собрана с liburing (MULTICAST_HAVE_LIBURING) и ядро
+// его разрешает; иначе транспорт сам откатывается на сокетные вызовы
+enum class IoBackend { Sockets, IoUring };
+
+// true, если библиотека собрана с liburing и ядро разрешает создать кольцо
+bool ioUringSupported();
+
+// Транспорт Sender'а: датаграммы чанков всем приёмникам группы и управляющие
+// сообщения от них. Пачки - это mmsghdr, как у sendmmsg/recvmmsg: адрес (msg_name)
+// заполняет сам транспорт, после отправки в msg_len - отправленные байты. sendBatch
+// зовут поток отправки и управляющий поток (перепосылка), receiveControl - только
+// управляющий поток
+class SenderTransport {
+   public:
+    virtual ~SenderTransport() = default;
+
+    // receiveControl ждёт сообщений не дольше controlTimeout
+    virtual bool open(std::chrono::microseconds controlTimeout) = 0;
+    virtual void close() = 0;
+    // Число отправленных датаграмм или -1 с errno
+    virtual int sendBatch(struct mmsghdr* messages, unsigned int count) = 0;
+    // Число принятых сообщений, 0 - таймаут, -1 - ошибка с errno
+    virtual int receiveControl(struct mmsghdr* messages, unsigned int count) = 0;
+};
+
+// Транспорт Receiver'а, его зовёт только поток приёма. sendControl шлёт сообщение
+// Sender'у, от которого пришли последние датаграммы. Датаграмма лежит по iov_base
+// своего сообщения: транспорт может направить его в собственный буфер, такой буфер
+// действителен до следующего receiveBatch
+class ReceiverTransport {
+   public:
+    virtual ~ReceiverTransport() = default;
+
+    // receiveBatch ждёт первой датаграммы не дольше receiveTimeout
+    virtual bool open(std::chrono::microseconds receiveTimeout) = 0;
+    virtual void close() = 0;
+    // Будит поток, ждущий в receiveBatch (остановка приёма)
+    virtual void wake() = 0;
+    // Как recvmmsg с MSG_WAITFORONE; обрезанная датаграмма помечается MSG_TRUNC
+    virtual int receiveBatch(struct mmsghdr* messages, unsigned int count) = 0;
+    virtual bool sendControl(const void* data, size_t len) = 0;
+    // Системные вызовы приёма с open(); у транспорта без сокетов - 0
+    virtual uint64_t syscallCount() const { return 0; }
+};
+
+// UDP multicast: данные в группу, управляющие сообщения на CONTROL_PORT Sender'а
+class UdpSenderTransport : public SenderTransport {
+   public:
+    // segmentationOffload - UDP GSO: подряд идущие датаграммы одной длины уходят одним
+    // буфером с UDP_SEGMENT, на датаграммы его режет ядро или сетевая карта
+    UdpSenderTransport(const std::string& multicastAddress, int port,
+                       bool segmentationOffload = false);
+    ~UdpSenderTransport() override;
+
+    bool open(std::chrono::microseconds controlTimeout) override;
+    void close() override;
+    int sendBatch(struct mmsghdr* messages, unsigned int count) override;
+    int receiveControl(struct mmsghdr* messages, unsigned int count) override;
+
+   protected:
+    // Отправка адресованных сообщений (с GSO - склеенных): sendmmsg. Контракт как у
+    // sendBatch
+    virtual int sendMessages(struct mmsghdr* messages, unsigned int count);
+
+    std::string multicastIP_;
+    int port_;
+    int sockfd_ = -1;
+    // Без управляющего сокета (порт занят) стрим идёт, но клиенты не видны
+    int controlSockfd_ = -1;
+    std::chrono::microseconds controlTimeout_{0};
+    struct sockaddr_in multicastAddr_{};
+
+   private:
+    // Склеивает пачку в gsoMessages_, возвращает число склеек
+    unsigned int coalesceBatch(struct mmsghdr* messages, unsigned int count);
+
+    bool segmentationOffload_;
+    // GSO включён и ещё не отвергнут ядром или интерфейсом
+    std::atomic<bool> gso_{false};
+    // sendBatch зовут два потока, склейки собираются в общих буферах
+    std::mutex gsoMutex_;
+    std::vector<mmsghdr> gsoMessages_;
+    std::vector<iovec> gsoIovecs_;
+    std::vector<uint8_t> gsoControl_;
+    // Сколько исходных датаграмм в каждой склейке
+    std::vector<unsigned int> gsoRuns_;
+};
+
+class UdpReceiverTransport : public ReceiverTransport {
+   public:
+    // recvBufferSize - желаемый SO_RCVBUF, 0 - системный. receiveOffload - UDP GRO: ядро
+    // отдаёт датаграммы потока склеенными, receiveBatch режет их обратно и отдаёт
+    // датаграммы из своего буфера
+    UdpReceiverTransport(const std::string& multicastAddress, int port, int recvBufferSize,
+                         bool receiveOffload = false);
+    ~UdpReceiverTransport() override;
+
+    bool open(std::chrono::microseconds receiveTimeout) override;
+    void close() override;
+    void wake() override;
+    int receiveBatch(struct mmsghdr* messages, unsigned int count) override;
+    bool sendControl(const void* data, size_t len) override;
+    uint64_t syscallCount() const override;
+
+   protected:
+    // Управляющие сообщения уходят Sender'у, приславшему датаграмму source
+    void rememberSource(const sockaddr_in& source);
+    // Выключает GRO на открытом сокете
+    void disableReceiveOffload();
+
+    std::string multicastIP_;
+    int port_;
+    int recvBufferSize_;
+    int sockfd_ = -1;
+    // Постоянный сокет для heartbeat'ов и NACK'ов на управляющий порт Sender'а
+    int controlSockfd_ = -1;
+    struct ip_mreq mreq_{};
+    // Адреса отправителей пачки и управляющий адрес последнего из них
+    std::vector<sockaddr_in> sourceAddrs_;
+    sockaddr_in controlAddr_{};
+    bool hasControlAddr_ = false;
+    // Пишет только поток приёма, читает статистика
+    std::atomic<uint64_t> syscalls_{0};
+
+   private:
+    int receiveCoalesced(struct mmsghdr* messages, unsigned int count);
+
+    bool receiveOffload_;
+    bool gro_ = false;
+    // Склеенные буферы последнего recvmmsg и позиция первой ещё не отданной датаграммы
+    std::vector<uint8_t> groBuffers_;
+    std::vector<uint8_t> groControl_;
+    std::vector<iovec> groIovecs_;
+    std::vector<mmsghdr> groMessages_;
+    unsigned int groReceived_ = 0;
+    unsigned int groNext_ = 0;
+    size_t groOffset_ = 0;
+};
+
+// UDP-транспорт с выбранным бэкендом
+std::unique_ptr<SenderTransport> makeUdpSenderTransport(const std::string& multicastAddress,
+                                                        int port, IoBackend backend,
+                                                        bool segmentationOffload = false);
+std::unique_ptr<ReceiverTransport> makeUdpReceiverTransport(const std::string& multicastAddress,
+                                                            int port, int recvBufferSize,
+                                                            IoBackend backend,
+                                                            bool receiveOffload = false);
+
+}  // namespace MulticastLib
+
+#endif  // TRANSPORT_H
@@ -0,0 +1,80 @@
+#ifndef URING_TRANSPORT_H
+#define URING_TRANSPORT_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "transport.h"
+
+struct io_uring;
+struct io_uring_buf_ring;
+
+namespace MulticastLib {
+
+// UDP multicast через io_uring. Сокеты те же, что у UdpSenderTransport; если кольцо
+// создать не удалось (нет liburing при сборке, старое ядро, запрет seccomp), open()
+// оставляет сокетный путь
+class UringSenderTransport : public UdpSenderTransport {
+   public:
+    UringSenderTransport(const std::string& multicastAddress, int port,
+                         bool segmentationOffload = false);
+    ~UringSenderTransport() override;
+
+    bool open(std::chrono::microseconds controlTimeout) override;
+    void close() override;
+
+   protected:
+    // Пачка - цепочка связанных sendmsg (IOSQE_IO_LINK) в одном io_uring_enter:
+    // датаграммы уходят по порядку, после первой ошибки остальные отменяются
+    int sendMessages(struct mmsghdr* messages, unsigned int count) override;
+
+   private:
+    // sendBatch зовут поток отправки и управляющий поток, кольцо - одно на двоих
+    std::mutex ringMutex_;
+    struct io_uring* ring_ = nullptr;
+};
+
+// Приём одним multishot recvmsg: ядро кладёт датаграммы в кольцо буферов
+// (provided buffer ring), receiveBatch отдаёт их без копирования и возвращает буферы
+// в кольцо на следующем вызове. Когда завершения уже лежат в очереди, системного
+// вызова нет вовсе
+class UringReceiverTransport : public UdpReceiverTransport {
+   public:
+    // GRO с кольцом не используется: буферы кольца размером с одну датаграмму
+    UringReceiverTransport(const std::string& multicastAddress, int port, int recvBufferSize,
+                           bool receiveOffload = false);
+    ~UringReceiverTransport() override;
+
+    bool open(std::chrono::microseconds receiveTimeout) override;
+    void close() override;
+    // shutdown не прерывает ожидание в io_uring_enter, поэтому будим через eventfd,
+    // чтение которого стоит в кольце рядом с recvmsg
+    void wake() override;
+    int receiveBatch(struct mmsghdr* messages, unsigned int count) override;
+
+   private:
+    bool setupRing();
+    void destroyRing();
+    void recycleBuffers();
+
+    struct io_uring* ring_ = nullptr;
+    struct io_uring_buf_ring* bufferRing_ = nullptr;
+    std::vector<uint8_t> buffers_;
+    // Шаблон multishot recvmsg: только длина адреса отправителя
+    struct msghdr recvTemplate_{};
+    bool armed_ = false;
+    int wakeFd_ = -1;
+    bool wakeArmed_ = false;
+    // Хоть одна датаграмма пришла через кольцо: до этого ошибка запроса - повод
+    // откатиться на recvmmsg
+    bool received_ = false;
+    std::chrono::microseconds receiveTimeout_{0};
+    // Буферы, отданные прошлым receiveBatch
+    std::vector<uint16_t> lent_;
+};
+
+}  // namespace MulticastLib
+
+#endif  // URING_TRANSPORT_H
@@ -0,0 +1,95 @@
+#ifndef VIDEO_FRAME_H
+#define VIDEO_FRAME_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace MulticastLib {
+
+// Опубликованный кадр. После публикации не изменяется и живёт, пока на него есть
+// ссылки, поэтому читатели получают его без копии
+struct VideoFrame {
+    cv::Mat image;
+    // Номер кадра: у приёмника - развёрнутый номер кадра потока, у превью - номер захвата.
+    // Растёт с каждым кадром и не бывает нулевым
+    uint64_t sequence = 0;
+    uint64_t captureTimestampUs = 0;
+    std::chrono::steady_clock::time_point publishTime;
+};
+
+// Принятый кадр в том виде, в каком его отправил Sender: один JPEG целиком
+struct EncodedVideoFrame {
+    std::vector<uint8_t> jpeg;
+    uint64_t sequence = 0;
+    uint64_t captureTimestampUs = 0;
+    std::chrono::steady_clock::time_point publishTime;
+};
+
+using FrameHandle = std::shared_ptr<const VideoFrame>;
+using EncodedFrameHandle = std::shared_ptr<const EncodedVideoFrame>;
+
+// Последний опубликованный кадр. publish() и load() - атомарные операции над
+// shared_ptr: читатель получает ссылку на неизменяемый кадр без копирования данных.
+// Они не lock-free: libstdc++ защищает указатель мьютексом из общего пула, но держит
+// его только на время копирования shared_ptr, а не пока кадр декодируется или читается
+template <typename Frame>
+class LatestFrame {
+   public:
+    using Handle = std::shared_ptr<const Frame>;
+
+    void publish(Handle frame) {
+        std::atomic_store_explicit(&frame_, std::move(frame), std::memory_order_release);
+    }
+
+    Handle load() const { return std::atomic_load_explicit(&frame_, std::memory_order_acquire); }
+
+   private:
+    Handle frame_;
+};
+
+// Буфер кадра, освободившегося в пуле, можно переписывать, если его не держит никто
+// другой. Заголовок изображения могли скопировать в чужую cv::Mat - тогда буфер ещё
+// читают, и кадр получит новый
+inline void reclaimFrameBuffer(VideoFrame& frame) {
+    if (frame.image.u && frame.image.u->refcount > 1) frame.image.release();
+}
+
+inline void reclaimFrameBuffer(EncodedVideoFrame&) {}
+
+// Пул кадров для публикации: кадр возвращается в оборот, когда на него не осталось
+// ссылок снаружи, и его буфер переиспользуется. acquire() вызывается одним потоком
+// за раз
+template <typename Frame>
+class FramePool {
+   public:
+    explicit FramePool(size_t capacity) {
+        for (size_t i = 0; i < capacity; ++i) frames_.push_back(std::make_shared<Frame>());
+    }
+
+    std::shared_ptr<Frame> acquire() {
+        // Свободен кадр, на который ссылается только пул. Новую ссылку можно получить
+        // только через публикацию, то есть из этого же потока; fence синхронизирует с
+        // потоком, отпустившим последнюю ссылку
+        for (auto& frame : frames_) {
+            if (frame.use_count() == 1) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                reclaimFrameBuffer(*frame);
+                return frame;
+            }
+        }
+        // Все кадры удерживают читатели - этот кадр живёт вне пула
+        return std::make_shared<Frame>();
+    }
+
+   private:
+    std::vector<std::shared_ptr<Frame>> frames_;
+};
+
+}  // namespace MulticastLib
+
+#endif  // VIDEO_FRAME_H
@@ -0,0 +1,52 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MulticastLib {
+
+// Пул потоков для параллельной обработки частей одного кадра (полос, тайлов).
+// run() раздаёт задачи 0..count-1 потокам пула и вызывающему потоку и возвращается,
+// когда выполнены все. run() вызывает один поток-владелец
+class WorkerPool {
+   public:
+    // threadCount - число исполнителей вместе с вызывающим потоком, 1 - без потоков
+    explicit WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const { return workers_.size() + 1; }
+
+    // task(index, worker): worker - номер исполнителя в [0, size()), по нему задача
+    // выбирает своё состояние (кодер, буфер). Вызывающий поток - исполнитель 0
+    void run(size_t count, const std::function<void(size_t, size_t)>& task);
+
+   private:
+    void workerLoop(size_t worker);
+    void runTasks(size_t worker);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable startCondition_;
+    std::condition_variable doneCondition_;
+    // Текущая пачка задач; меняется под mutex_ только между вызовами run()
+    const std::function<void(size_t, size_t)>* task_ = nullptr;
+    size_t taskCount_ = 0;
+    std::atomic<size_t> nextTask_{0};
+    uint64_t generation_ = 0;
+    size_t activeWorkers_ = 0;
+    bool stopping_ = false;
+};
+
+}  // namespace MulticastLib
+
+#endif  // WORKER_POOL_H
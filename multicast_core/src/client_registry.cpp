@@ -0,0 +1,117 @@
+#include "client_registry.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Шагов гистограммы потерь: худшая доля потерь известна с точностью до 0.1%
+#define LOSS_HISTOGRAM_STEPS 1000
+
+namespace MulticastLib {
+
+uint64_t clientKey(std::string_view clientID) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : clientID) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ClientRegistry::ClientRegistry(Clock::duration timeout, Clock::duration tick)
+    : timeout_(timeout),
+      tick_(std::max(tick, Clock::duration(1))),
+      wheel_(timeout_ / tick_ + 2),
+      lossHistogram_(LOSS_HISTOGRAM_STEPS + 1, 0) {}
+
+size_t ClientRegistry::slotFor(Clock::time_point deadline) const {
+    // Ячейка не раньше следующего непройденного тика, иначе клиент прождёт лишний оборот
+    int64_t tick = deadline.time_since_epoch() / tick_;
+    tick = std::max(tick, currentTick_ + 1);
+    return static_cast<size_t>(tick) % wheel_.size();
+}
+
+bool ClientRegistry::heartbeat(uint64_t key, double lossRatio, double fps,
+                               Clock::time_point now) {
+    // Доля потерь округляется вверх, чтобы малые потери не обнулялись
+    lossRatio = std::isfinite(lossRatio) ? std::clamp(lossRatio, 0.0, 1.0) : 0.0;
+    auto bucket = static_cast<uint16_t>(std::ceil(lossRatio * LOSS_HISTOGRAM_STEPS));
+
+    auto [it, inserted] = clients_.try_emplace(key);
+    Client& client = it->second;
+    client.lastHeartbeat = now;
+    client.fps = fps;
+    if (!inserted) {
+        setLossBucket(client, bucket);
+        return false;
+    }
+
+    client.lossBucket = bucket;
+    addToLossBucket(bucket);
+    wheel_[slotFor(now + timeout_)].push_back(key);
+    size_.store(clients_.size(), std::memory_order_relaxed);
+    return true;
+}
+
+size_t ClientRegistry::expire(Clock::time_point now, const ExpireCallback& onExpire) {
+    const int64_t nowTick = now.time_since_epoch() / tick_;
+    if (currentTick_ < 0) currentTick_ = nowTick - 1;
+    // После долгой паузы каждая ячейка проходится один раз, а не по числу пропущенных тиков
+    int64_t tick = std::max(currentTick_ + 1, nowTick - static_cast<int64_t>(wheel_.size()) + 1);
+
+    size_t expired = 0;
+    for (; tick <= nowTick; ++tick) {
+        expiring_.swap(wheel_[static_cast<size_t>(tick) % wheel_.size()]);
+        currentTick_ = tick;
+        for (uint64_t key : expiring_) {
+            auto it = clients_.find(key);
+            if (it == clients_.end()) continue;
+
+            Clock::time_point deadline = it->second.lastHeartbeat + timeout_;
+            if (deadline > now) {
+                wheel_[slotFor(deadline)].push_back(key);
+                continue;
+            }
+            removeFromLossBucket(it->second.lossBucket);
+            clients_.erase(it);
+            expired++;
+            if (onExpire) onExpire(key);
+        }
+        expiring_.clear();
+    }
+    if (expired > 0) size_.store(clients_.size(), std::memory_order_relaxed);
+    return expired;
+}
+
+void ClientRegistry::clear() {
+    for (auto& slot : wheel_) slot.clear();
+    clients_.clear();
+    std::fill(lossHistogram_.begin(), lossHistogram_.end(), 0);
+    worstBucket_ = 0;
+    currentTick_ = -1;
+    size_.store(0, std::memory_order_relaxed);
+    worstLoss_.store(0.0, std::memory_order_relaxed);
+}
+
+void ClientRegistry::setLossBucket(Client& client, uint16_t bucket) {
+    if (client.lossBucket == bucket) return;
+    removeFromLossBucket(client.lossBucket);
+    addToLossBucket(bucket);
+    client.lossBucket = bucket;
+}
+
+void ClientRegistry::addToLossBucket(size_t bucket) {
+    lossHistogram_[bucket]++;
+    if (bucket <= worstBucket_) return;
+    worstBucket_ = bucket;
+    worstLoss_.store(double(bucket) / LOSS_HISTOGRAM_STEPS, std::memory_order_relaxed);
+}
+
+void ClientRegistry::removeFromLossBucket(size_t bucket) {
+    lossHistogram_[bucket]--;
+    if (bucket != worstBucket_ || lossHistogram_[bucket] > 0) return;
+    // Ушёл последний клиент с худшими потерями - ищем следующего вниз по гистограмме
+    while (worstBucket_ > 0 && lossHistogram_[worstBucket_] == 0) worstBucket_--;
+    worstLoss_.store(double(worstBucket_) / LOSS_HISTOGRAM_STEPS, std::memory_order_relaxed);
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,90 @@
+#include "fec.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FEC_HAVE_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FEC_HAVE_NEON 1
+#endif
+
+namespace MulticastLib {
+
+namespace {
+
+void xorScalar(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < len; ++i) dst[i] ^= src[i];
+}
+
+#if defined(FEC_HAVE_X86)
+#if defined(__SSE2__)
+void xorSse2(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(a, b));
+    }
+    xorScalar(dst + i, src + i, len - i);
+}
+#endif
+
+__attribute__((target("avx2"))) void xorAvx2(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(a, b));
+    }
+    xorScalar(dst + i, src + i, len - i);
+}
+#endif
+
+#if defined(FEC_HAVE_NEON)
+void xorNeon(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+    xorScalar(dst + i, src + i, len - i);
+}
+#endif
+
+using XorKernel = void (*)(uint8_t*, const uint8_t*, size_t);
+
+XorKernel selectKernel() {
+#if defined(FEC_HAVE_X86)
+    if (__builtin_cpu_supports("avx2")) return xorAvx2;
+#if defined(__SSE2__)
+    return xorSse2;
+#endif
+#elif defined(FEC_HAVE_NEON)
+    return xorNeon;
+#endif
+    return xorScalar;
+}
+
+}  // namespace
+
+void xorInto(uint8_t* dst, const uint8_t* src, size_t len) {
+    static const XorKernel kernel = selectKernel();
+    kernel(dst, src, len);
+}
+
+void computeParity(uint8_t* parity, const uint8_t* const* chunks, const size_t* lengths,
+                   size_t count, size_t chunkSize) {
+    memset(parity, 0, chunkSize);
+    for (size_t i = 0; i < count; ++i) xorInto(parity, chunks[i], lengths[i]);
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,271 @@
+#include "frame_assembler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "fec.h"
+
+namespace MulticastLib {
+
+// Скачок номера назад больше чем на это число кадров считается перезапуском Sender'а
+#define SEQUENCE_RESYNC_WINDOW 1024
+
+FrameAssembler::FrameAssembler(size_t slotCount, size_t maxFrameSize)
+    : slots_(slotCount),
+      maxFrameSize_(maxFrameSize),
+      maxChunks_((maxFrameSize + MIN_CHUNK_SIZE - 1) / MIN_CHUNK_SIZE) {
+    for (auto& slot : slots_) {
+        // Без value-инициализации: страницы буфера занимаются ядром по мере записи.
+        // Чётность групп занимает до chunkSize байт сверх размера кадра
+        slot.data.reset(new uint8_t[maxFrameSize_]);
+        slot.bitmap.assign((maxChunks_ + 63) / 64, 0);
+        slot.parity.reset(new uint8_t[maxFrameSize_ + MAX_CHUNK_SIZE]);
+        slot.parityBitmap.assign((maxChunks_ + 63) / 64, 0);
+    }
+}
+
+uint64_t FrameAssembler::unwrapSequence(uint32_t frameSeq) {
+    // Первый номер кладётся далеко от нуля, чтобы отставшие кадры не уходили в минус
+    if (!hasNewest_) {
+        hasNewest_ = true;
+        newestFrameSeq_ = frameSeq;
+        newestSequence_ = uint64_t(1) << 32;
+        return newestSequence_;
+    }
+
+    int64_t diff = static_cast<int32_t>(frameSeq - newestFrameSeq_);
+    if (diff < -SEQUENCE_RESYNC_WINDOW) diff = SEQUENCE_RESYNC_WINDOW;  // новый поток новее всех
+    uint64_t sequence = newestSequence_ + diff;
+    if (diff > 0) {
+        newestFrameSeq_ = frameSeq;
+        newestSequence_ = sequence;
+    }
+    return sequence;
+}
+
+FrameAssembler::Slot* FrameAssembler::slotFor(const ChunkInfo& info, Result* result) {
+    if (info.frameSize > maxFrameSize_) {
+        *result = Result::Rejected;
+        return nullptr;
+    }
+
+    uint64_t sequence = unwrapSequence(info.frameSeq);
+    Slot& slot = slots_[sequence % slots_.size()];
+    // acquire: парный release() в потоке декодера, буфер им больше не читается
+    SlotState state = slot.state.load(std::memory_order_acquire);
+
+    if (slot.sequence == sequence) {
+        if (state != SlotState::Assembling) {
+            *result = Result::Stale;  // кадр уже собран или сброшен
+            return nullptr;
+        }
+        bool consistent = slot.totalChunks == info.totalChunks &&
+                          slot.chunkSize == info.chunkSize &&
+                          slot.frameSize == info.frameSize && slot.fecGroup == info.fecGroup &&
+                          slot.flags == (info.flags & CHUNK_FRAME_FLAGS);
+        *result = consistent ? Result::Incomplete : Result::Rejected;
+        return consistent ? &slot : nullptr;
+    }
+
+    // В слоте кадр новее, или более старый кадр ещё декодируется
+    if (slot.sequence > sequence || state == SlotState::Completed) {
+        *result = Result::Stale;
+        return nullptr;
+    }
+
+    // Вытесняем недособранный более старый кадр
+    if (state == SlotState::Assembling) droppedFrames_++;
+
+    slot.state.store(SlotState::Assembling, std::memory_order_relaxed);
+    slot.sequence = sequence;
+    slot.frameSeq = info.frameSeq;
+    slot.captureTimestampUs = info.captureTimestampUs;
+    slot.totalChunks = info.totalChunks;
+    slot.chunkSize = info.chunkSize;
+    slot.frameSize = info.frameSize;
+    slot.fecGroup = info.fecGroup;
+    slot.flags = info.flags & CHUNK_FRAME_FLAGS;
+    slot.encodeDelayUs = info.encodeDelayUs;
+    slot.sendDelayUs = info.sendDelayUs;
+    slot.firstTimestamp = Clock::now();
+    slot.receivedChunks = 0;
+    slot.nackCount = 0;
+    std::fill_n(slot.bitmap.begin(), (info.totalChunks + 63) / 64, 0);
+    std::fill_n(slot.parityBitmap.begin(), (info.totalChunks + 63) / 64, 0);
+    *result = Result::Incomplete;
+    return &slot;
+}
+
+size_t FrameAssembler::chunkLength(const Slot& slot, size_t chunk) const {
+    return std::min<size_t>(slot.chunkSize, slot.frameSize - chunk * slot.chunkSize);
+}
+
+static bool testBit(const std::vector<uint64_t>& bitmap, size_t i) {
+    return bitmap[i / 64] & (uint64_t(1) << (i % 64));
+}
+
+static void setBit(std::vector<uint64_t>& bitmap, size_t i) {
+    bitmap[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+void FrameAssembler::tryRecover(Slot& slot, size_t group) {
+    if (slot.fecGroup == 0 || !testBit(slot.parityBitmap, group)) return;
+
+    size_t first = group * slot.fecGroup;
+    size_t last = std::min<size_t>(first + slot.fecGroup, slot.totalChunks);
+    size_t missing = last;
+    for (size_t i = first; i < last; ++i) {
+        if (testBit(slot.bitmap, i)) continue;
+        if (missing != last) return;  // не хватает больше одного чанка
+        missing = i;
+    }
+    if (missing == last) return;
+
+    // missing = parity ^ XOR остальных чанков группы (за их длиной - нули)
+    const size_t chunkSize = slot.chunkSize;
+    size_t len = chunkLength(slot, missing);
+    uint8_t* dst = slot.data.get() + missing * chunkSize;
+    memcpy(dst, slot.parity.get() + group * chunkSize, len);
+    for (size_t i = first; i < last; ++i) {
+        if (i == missing) continue;
+        xorInto(dst, slot.data.get() + i * chunkSize, std::min(chunkLength(slot, i), len));
+    }
+
+    setBit(slot.bitmap, missing);
+    slot.receivedChunks++;
+    recoveredChunks_++;
+}
+
+void FrameAssembler::complete(Slot& slot, CompletedFrame* completed) {
+    slot.state.store(SlotState::Completed, std::memory_order_relaxed);
+    completed->slot = static_cast<size_t>(&slot - slots_.data());
+    completed->sequence = slot.sequence;
+    completed->frameSeq = slot.frameSeq;
+    completed->captureTimestampUs = slot.captureTimestampUs;
+    completed->flags = slot.flags;
+    completed->data = slot.data.get();
+    completed->size = slot.frameSize;
+    completed->totalChunks = slot.totalChunks;
+    completed->chunkSize = slot.chunkSize;
+    completed->receivedChunks = slot.receivedChunks;
+    completed->chunkBitmap = nullptr;
+    completed->firstPacketTime = slot.firstTimestamp;
+    completed->lastPacketTime = slot.timestamp;
+    completed->encodeDelayUs = slot.encodeDelayUs;
+    completed->sendDelayUs = slot.sendDelayUs;
+}
+
+FrameAssembler::Result FrameAssembler::finish(Slot& slot, CompletedFrame* completed) {
+    if (slot.receivedChunks != slot.totalChunks) return Result::Incomplete;
+    complete(slot, completed);
+    return Result::Completed;
+}
+
+FrameAssembler::Result FrameAssembler::addChunk(const ChunkInfo& info, const uint8_t* payload,
+                                                CompletedFrame* completed) {
+    Result result;
+    Slot* slot = slotFor(info, &result);
+    if (!slot) return result;
+
+    if (testBit(slot->bitmap, info.chunkIndex)) return Result::Duplicate;
+
+    setBit(slot->bitmap, info.chunkIndex);
+    memcpy(slot->data.get() + size_t(info.chunkIndex) * info.chunkSize, payload, info.payloadLen);
+    slot->receivedChunks++;
+    slot->timestamp = Clock::now();
+
+    if (slot->fecGroup) tryRecover(*slot, info.chunkIndex / slot->fecGroup);
+    return finish(*slot, completed);
+}
+
+FrameAssembler::Result FrameAssembler::addParity(const ChunkInfo& info, const uint8_t* parity,
+                                                 CompletedFrame* completed) {
+    Result result;
+    Slot* slot = slotFor(info, &result);
+    if (!slot) return result;
+
+    const uint16_t group = info.chunkIndex;
+    if (testBit(slot->parityBitmap, group)) return Result::Duplicate;
+
+    setBit(slot->parityBitmap, group);
+    memcpy(slot->parity.get() + size_t(group) * info.chunkSize, parity, info.payloadLen);
+    slot->timestamp = Clock::now();
+
+    tryRecover(*slot, group);
+    return finish(*slot, completed);
+}
+
+void FrameAssembler::release(size_t slot) {
+    if (slot < slots_.size()) slots_[slot].state.store(SlotState::Free, std::memory_order_release);
+}
+
+void FrameAssembler::dropExpired(Clock::time_point olderThan, const DropCallback& onDrop) {
+    for (auto& slot : slots_) {
+        if (slot.state.load(std::memory_order_relaxed) == SlotState::Assembling &&
+            slot.timestamp < olderThan) {
+            if (onDrop) onDrop(slot.frameSeq, slot.totalChunks - slot.receivedChunks);
+            slot.state.store(SlotState::Free, std::memory_order_relaxed);
+            droppedFrames_++;
+        }
+    }
+}
+
+size_t FrameAssembler::collectNacks(Clock::time_point now, Clock::duration quietTime,
+                                    Clock::duration retryInterval, int maxRetries,
+                                    NackRequest* out, size_t maxRequests) {
+    size_t count = 0;
+    for (auto& slot : slots_) {
+        if (count == maxRequests) break;
+        if (slot.state.load(std::memory_order_relaxed) != SlotState::Assembling) continue;
+        if (now - slot.timestamp < quietTime || slot.nackCount >= maxRetries) continue;
+        if (slot.nackCount > 0 && now - slot.lastNack < retryInterval) continue;
+
+        NackRequest& request = out[count];
+        request.frameSeq = slot.frameSeq;
+        request.rangeCount = 0;
+        for (size_t i = 0; i < slot.totalChunks && request.rangeCount < MAX_NACK_RANGES;) {
+            if (testBit(slot.bitmap, i)) {
+                ++i;
+                continue;
+            }
+            size_t from = i;
+            while (i < slot.totalChunks && !testBit(slot.bitmap, i)) ++i;
+            request.ranges[request.rangeCount][0] = static_cast<uint16_t>(from);
+            request.ranges[request.rangeCount][1] = static_cast<uint16_t>(i - 1);
+            request.rangeCount++;
+        }
+
+        slot.lastNack = now;
+        slot.nackCount++;
+        count++;
+    }
+    return count;
+}
+
+size_t FrameAssembler::collectPartial(Clock::time_point now, Clock::duration quietTime,
+                                      CompletedFrame* out, size_t maxFrames) {
+    const uint8_t required = CHUNK_FLAG_SEGMENTED | CHUNK_FLAG_ALIGNED;
+    size_t count = 0;
+    for (auto& slot : slots_) {
+        if (count == maxFrames) break;
+        if (slot.state.load(std::memory_order_relaxed) != SlotState::Assembling) continue;
+        if ((slot.flags & required) != required || slot.receivedChunks == 0) continue;
+        if (now - slot.timestamp < quietTime) continue;
+
+        // Маска остаётся в слоте до release(): слот не переиспользуется, пока он Completed
+        complete(slot, &out[count]);
+        out[count].chunkBitmap = slot.bitmap.data();
+        count++;
+    }
+    return count;
+}
+
+size_t FrameAssembler::inFlightFrames() const {
+    size_t count = 0;
+    for (const auto& slot : slots_) {
+        if (slot.state.load(std::memory_order_relaxed) == SlotState::Assembling) count++;
+    }
+    return count;
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,200 @@
+#include "frame_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+// Столько последних микросекунд до дедлайна кадра поток не спит
+#define PACE_SPIN_US 200
+// Timer slack потока захвата, нс (по умолчанию у потоков 50 мкс)
+#define PACE_TIMER_SLACK_NS 1000
+// Сдвиг движущейся части синтетического кадра за кадр, пикселей
+#define SYNTHETIC_SCROLL_PX 8
+// Клетка номера кадра в синтетическом кадре, пикселей
+#define SYNTHETIC_CELL_PX 8
+#define SYNTHETIC_SEED 0x9e3779b97f4a7c15ULL
+
+namespace MulticastLib {
+
+std::unique_ptr<FrameSource> makeFrameSource(const FrameSourceConfig& config) {
+    switch (config.type) {
+        case FrameSourceType::VideoFile:
+            return std::make_unique<VideoFileSource>(config.path, config.loop);
+        case FrameSourceType::RawFile:
+            return std::make_unique<RawFileSource>(config.path, config.width, config.height,
+                                                   config.loop);
+        case FrameSourceType::Synthetic:
+            return std::make_unique<SyntheticSource>(config.width, config.height, config.motion);
+        default:
+            return std::make_unique<CameraSource>(config.cameraIndex);
+    }
+}
+
+CameraSource::CameraSource(int index) : index_(index) {}
+
+bool CameraSource::open() { return camera_.open(index_, cv::CAP_ANY); }
+
+bool CameraSource::read(cv::Mat& image) {
+    camera_ >> image;
+    return !image.empty();
+}
+
+void CameraSource::close() { camera_.release(); }
+
+std::string CameraSource::name() const { return "camera " + std::to_string(index_); }
+
+VideoFileSource::VideoFileSource(const std::string& path, bool loop) : path_(path), loop_(loop) {}
+
+bool VideoFileSource::open() {
+    exhausted_ = false;
+    return capture_.open(path_);
+}
+
+bool VideoFileSource::read(cv::Mat& image) {
+    if (capture_.read(image) && !image.empty()) return true;
+    if (!loop_) {
+        exhausted_ = true;
+        return false;
+    }
+    capture_.set(cv::CAP_PROP_POS_FRAMES, 0);
+    return capture_.read(image) && !image.empty();
+}
+
+void VideoFileSource::close() { capture_.release(); }
+
+RawFileSource::RawFileSource(const std::string& path, int width, int height, bool loop)
+    : path_(path), width_(width), height_(height), loop_(loop) {}
+
+RawFileSource::~RawFileSource() { close(); }
+
+bool RawFileSource::open() {
+    close();
+    if (width_ <= 0 || height_ <= 0) return false;
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ::close(fd);
+        return false;
+    }
+    frameBytes_ = static_cast<size_t>(width_) * height_ * 3;
+    frameCount_ = static_cast<size_t>(st.st_size) / frameBytes_;
+    if (frameCount_ == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // Отображение держит файл открытым само, дескриптор больше не нужен
+    mappingSize_ = frameCount_ * frameBytes_;
+    void* mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, mappingSize_, MADV_SEQUENTIAL);
+    mapping_ = static_cast<const uint8_t*>(mapping);
+    nextFrame_ = 0;
+    exhausted_ = false;
+    return true;
+}
+
+bool RawFileSource::read(cv::Mat& image) {
+    if (!mapping_) return false;
+    if (nextFrame_ == frameCount_) {
+        if (!loop_) {
+            exhausted_ = true;
+            return false;
+        }
+        nextFrame_ = 0;
+    }
+    image.create(height_, width_, CV_8UC3);
+    memcpy(image.data, mapping_ + nextFrame_ * frameBytes_, frameBytes_);
+    ++nextFrame_;
+    return true;
+}
+
+void RawFileSource::close() {
+    if (!mapping_) return;
+    munmap(const_cast<uint8_t*>(mapping_), mappingSize_);
+    mapping_ = nullptr;
+}
+
+SyntheticSource::SyntheticSource(int width, int height, double motion)
+    : width_(std::max(width, SYNTHETIC_CELL_PX)),
+      height_(std::max(height, SYNTHETIC_CELL_PX)),
+      movingRows_(static_cast<int>(std::clamp(motion, 0.0, 1.0) * height_ + 0.5)) {}
+
+bool SyntheticSource::open() {
+    // Градиент с шумом от генератора с фиксированным зерном: сжимается примерно как
+    // картинка с камеры и не зависит от реализации RNG в OpenCV
+    background_.create(height_, width_, CV_8UC3);
+    uint64_t state = SYNTHETIC_SEED;
+    for (int y = 0; y < height_; ++y) {
+        uint8_t* row = background_.ptr<uint8_t>(y);
+        for (int x = 0; x < width_; ++x) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            int noise = static_cast<int>(state & 15);
+            row[3 * x] = static_cast<uint8_t>(x * 239 / width_ + noise);
+            row[3 * x + 1] = static_cast<uint8_t>(y * 239 / height_ + noise);
+            row[3 * x + 2] = static_cast<uint8_t>(((x / 64 + y / 64) & 1) * 160 + noise);
+        }
+    }
+    frameIndex_ = 0;
+    return true;
+}
+
+bool SyntheticSource::read(cv::Mat& image) {
+    if (background_.empty()) return false;
+    image.create(height_, width_, CV_8UC3);
+
+    // Движущаяся часть - фон, сдвинутый по кругу; остальное неподвижно
+    int shift = static_cast<int>(frameIndex_ * SYNTHETIC_SCROLL_PX % width_);
+    if (movingRows_ > 0) {
+        cv::Mat head = image(cv::Rect(0, 0, width_ - shift, movingRows_));
+        background_(cv::Rect(shift, 0, width_ - shift, movingRows_)).copyTo(head);
+        if (shift > 0) {
+            cv::Mat tail = image(cv::Rect(width_ - shift, 0, shift, movingRows_));
+            background_(cv::Rect(0, 0, shift, movingRows_)).copyTo(tail);
+        }
+    }
+    if (movingRows_ < height_) {
+        cv::Mat still = image.rowRange(movingRows_, height_);
+        background_.rowRange(movingRows_, height_).copyTo(still);
+    }
+
+    // Номер кадра: по биту на клетку, так кадры различимы и при нулевом движении
+    int cells = std::min(32, width_ / SYNTHETIC_CELL_PX);
+    for (int bit = 0; bit < cells; ++bit) {
+        double value = (frameIndex_ >> bit) & 1 ? 255 : 0;
+        image(cv::Rect(bit * SYNTHETIC_CELL_PX, 0, SYNTHETIC_CELL_PX, SYNTHETIC_CELL_PX))
+            .setTo(cv::Scalar(value, value, value));
+    }
+    ++frameIndex_;
+    return true;
+}
+
+void FramePacer::start() {
+    prctl(PR_SET_TIMERSLACK, PACE_TIMER_SLACK_NS, 0, 0, 0);
+    deadline_ = Clock::now();
+}
+
+bool FramePacer::waitNext(Clock::duration interval) {
+    deadline_ += interval;
+    auto now = Clock::now();
+    if (now > deadline_ + interval) {
+        deadline_ = now;
+        return false;
+    }
+    auto spinFrom = deadline_ - std::chrono::microseconds(PACE_SPIN_US);
+    if (now < spinFrom) std::this_thread::sleep_until(spinFrom);
+    while (Clock::now() < deadline_) std::this_thread::yield();
+    return true;
+}
+
+}  // namespace MulticastLib
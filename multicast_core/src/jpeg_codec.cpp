@@ -0,0 +1,148 @@
+#include "jpeg_codec.h"
+
+#include <new>
+
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+#include <turbojpeg.h>
+#endif
+
+namespace MulticastLib {
+
+bool jpegCodecAccelerated() {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    return true;
+#else
+    return false;
+#endif
+}
+
+JpegEncoder::JpegEncoder() : params_{cv::IMWRITE_JPEG_QUALITY, 80} {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    handle_ = tjInitCompress();
+#endif
+}
+
+JpegEncoder::~JpegEncoder() {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    if (buffer_) tjFree(buffer_);
+    if (handle_) tjDestroy(handle_);
+#endif
+}
+
+bool JpegEncoder::encode(const cv::Mat& image, int quality, std::vector<uchar>& out) {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    if (handle_ && image.type() == CV_8UC3 && !image.empty()) {
+        // Буфер растёт только при увеличении кадра; NOREALLOC запрещает TurboJPEG
+        // выделять память самому
+        unsigned long required = tjBufSize(image.cols, image.rows, TJSAMP_420);
+        if (required > bufferSize_) {
+            if (buffer_) tjFree(buffer_);
+            buffer_ = tjAlloc(static_cast<int>(required));
+            bufferSize_ = buffer_ ? required : 0;
+        }
+
+        unsigned char* jpeg = buffer_;
+        unsigned long jpegSize = bufferSize_;
+        if (buffer_ &&
+            tjCompress2(static_cast<tjhandle>(handle_), image.data, image.cols,
+                        static_cast<int>(image.step), image.rows, TJPF_BGR, &jpeg, &jpegSize,
+                        TJSAMP_420, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT) == 0) {
+            out.assign(jpeg, jpeg + jpegSize);
+            return true;
+        }
+    }
+#endif
+    params_[1] = quality;
+    return cv::imencode(".jpg", image, out, params_);
+}
+
+JpegDecoder::JpegDecoder(size_t maxPixels) : maxPixels_(maxPixels) {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    handle_ = tjInitDecompress();
+#endif
+}
+
+JpegDecoder::~JpegDecoder() {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    if (handle_) tjDestroy(handle_);
+#endif
+}
+
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+namespace {
+
+// Предупреждения libjpeg (например, лишние байты после EOI) картинку не портят
+bool tjSucceeded(tjhandle handle, int result) {
+    return result == 0 || tjGetErrorCode(handle) == TJERR_WARNING;
+}
+
+}  // namespace
+#endif
+
+bool JpegDecoder::decode(const uint8_t* data, size_t size, cv::Mat& out) {
+    // Кадр пришёл из сети: битый или огромный не должен ронять поток декодирования
+    try {
+        return decodeBgr(data, size, out);
+    } catch (const cv::Exception&) {
+        return false;
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+}
+
+bool JpegDecoder::decodeYuv(const uint8_t* data, size_t size, cv::Mat& out) {
+    try {
+        return decodeI420(data, size, out);
+    } catch (const cv::Exception&) {
+        return false;
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+}
+
+bool JpegDecoder::decodeBgr(const uint8_t* data, size_t size, cv::Mat& out) {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    if (handle_) {
+        tjhandle handle = static_cast<tjhandle>(handle_);
+        int width, height, subsamp, colorspace;
+        if (tjDecompressHeader3(handle, data, size, &width, &height, &subsamp, &colorspace) != 0 ||
+            static_cast<size_t>(width) * static_cast<size_t>(height) > maxPixels_) {
+            return false;
+        }
+        out.create(height, width, CV_8UC3);
+        return tjSucceeded(handle, tjDecompress2(handle, data, size, out.data, width,
+                                                 static_cast<int>(out.step), height, TJPF_BGR,
+                                                 TJFLAG_FASTDCT));
+    }
+#endif
+    cv::Mat encoded(1, static_cast<int>(size), CV_8U, const_cast<uint8_t*>(data));
+    // Размеры без TurboJPEG заранее не узнать: OpenCV сам отвергает кадры больше
+    // CV_IO_MAX_IMAGE_PIXELS, а потолок проверяется уже по результату
+    cv::imdecode(encoded, cv::IMREAD_COLOR, &out);
+    return !out.empty() && out.total() <= maxPixels_;
+}
+
+bool JpegDecoder::decodeI420(const uint8_t* data, size_t size, cv::Mat& out) {
+#if defined(MULTICAST_HAVE_TURBOJPEG)
+    if (handle_) {
+        tjhandle handle = static_cast<tjhandle>(handle_);
+        int width, height, subsamp, colorspace;
+        if (tjDecompressHeader3(handle, data, size, &width, &height, &subsamp, &colorspace) != 0 ||
+            static_cast<size_t>(width) * static_cast<size_t>(height) > maxPixels_) {
+            return false;
+        }
+        // Плоскости Y, U, V подряд без выравнивания строк - это и есть I420
+        if (subsamp == TJSAMP_420 && width % 2 == 0 && height % 2 == 0) {
+            out.create(height * 3 / 2, width, CV_8UC1);
+            return tjSucceeded(handle, tjDecompressToYUV2(handle, data, size, out.data, width, 1,
+                                                          height, TJFLAG_FASTDCT));
+        }
+    }
+#endif
+    // Запасной путь: BGR и преобразование; I420 требует чётных размеров
+    if (!decodeBgr(data, size, bgr_) || bgr_.cols % 2 || bgr_.rows % 2) return false;
+    cv::cvtColor(bgr_, out, cv::COLOR_BGR2YUV_I420);
+    return true;
+}
+
+}  // namespace MulticastLib
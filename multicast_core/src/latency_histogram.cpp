@@ -0,0 +1,71 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+
+namespace MulticastLib {
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    // Значения меньше SUB_BUCKETS лежат в линейных корзинах один к одному
+    if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+    size_t exponent = 63 - __builtin_clzll(value);
+    if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+    size_t sub = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t index) {
+    if (index < SUB_BUCKETS) return index;
+    size_t exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t width = uint64_t(1) << (exponent - SUB_BUCKET_BITS);
+    uint64_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) * width;
+    return lower + width / 2;
+}
+
+void LatencyHistogram::record(uint64_t valueUs) {
+    counts_[bucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(valueUs, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (valueUs > max && !max_.compare_exchange_weak(max, valueUs, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    // Снимок корзин; total считается по нему же, чтобы квантили были согласованы
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] = counts_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    LatencySummary summary;
+    summary.count = total;
+    if (total == 0) return summary;
+
+    const uint64_t max = max_.load(std::memory_order_relaxed);
+    const double quantiles[] = {0.5, 0.99, 0.999};
+    double* results[] = {&summary.p50Ms, &summary.p99Ms, &summary.p999Ms};
+    uint64_t seen = 0;
+    size_t q = 0;
+    for (size_t i = 0; i < BUCKETS && q < 3; ++i) {
+        seen += counts[i];
+        while (q < 3 && seen >= quantiles[q] * total) {
+            // Середина корзины не может быть больше наблюдавшегося максимума
+            *results[q++] = std::min(bucketValue(i), max) / 1000.0;
+        }
+    }
+    summary.meanMs = double(sum_.load(std::memory_order_relaxed)) /
+                     std::max<uint64_t>(1, total_.load(std::memory_order_relaxed)) / 1000.0;
+    summary.maxMs = max / 1000.0;
+    return summary;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& count : counts_) count.store(0, std::memory_order_relaxed);
+    total_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,337 @@
+#include "logging.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Записей в кольце одного потока; при переполнении новые записи теряются
+#define LOG_RING_CAPACITY 512
+// Как часто фоновый поток забирает записи (ошибки будят его сразу)
+#define LOG_DRAIN_INTERVAL_MS 20
+// Окно ограничения частоты записей с одного места и лимит по умолчанию
+#define LOG_RATE_WINDOW_US 1000000
+#define DEFAULT_LOG_RATE_LIMIT 20
+
+namespace MulticastLib {
+
+namespace {
+
+int64_t steadyUs(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+// Запись кольца: строка журнала или интервал трассировки
+struct Entry {
+    bool span = false;
+    LogRecord record;
+    // Только у интервалов: имя и категория - строковые литералы, начало в мкс по
+    // steady_clock
+    const char* name = nullptr;
+    const char* category = nullptr;
+    int64_t startUs = 0;
+    int64_t durationUs = 0;
+    uint64_t id = 0;
+};
+
+// Кольцо одного потока: пишет только он, читает только фоновый поток журнала
+struct ThreadRing {
+    Entry entries[LOG_RING_CAPACITY];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    uint32_t threadId = 0;
+
+    Entry* reserve() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == LOG_RING_CAPACITY) return nullptr;
+        return &entries[h % LOG_RING_CAPACITY];
+    }
+
+    void commit() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace:
+            return "TRACE";
+        case LogLevel::Debug:
+            return "DEBUG";
+        case LogLevel::Info:
+            return "INFO";
+        case LogLevel::Warning:
+            return "WARN";
+        case LogLevel::Error:
+            return "ERROR";
+        default:
+            return "?";
+    }
+}
+
+class LogWriter {
+   public:
+    // Объект не разрушается: потоки могут писать в журнал и во время выхода из программы
+    static LogWriter& instance() {
+        static LogWriter* writer = new LogWriter();
+        return *writer;
+    }
+
+    ThreadRing* localRing() {
+        thread_local std::shared_ptr<ThreadRing> ring = registerRing();
+        return ring.get();
+    }
+
+    void wake() { drainCv_.notify_one(); }
+    int rateLimit() const { return rateLimit_.load(std::memory_order_relaxed); }
+    void setRateLimit(int limit) { rateLimit_.store(limit, std::memory_order_relaxed); }
+    void countDropped() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    void setSink(LogSink sink) {
+        std::lock_guard<std::mutex> lock(drainMutex_);
+        sink_ = std::move(sink);
+    }
+
+    bool startTrace(const std::string& path) {
+        std::lock_guard<std::mutex> lock(drainMutex_);
+        if (traceFile_) return false;
+        traceFile_ = fopen(path.c_str(), "w");
+        if (!traceFile_) return false;
+        fputs("[\n", traceFile_);
+        firstSpan_ = true;
+        detail::traceEnabled.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void stopTrace() {
+        detail::traceEnabled.store(false, std::memory_order_relaxed);
+        // Уже записанные интервалы попадают в файл до закрывающей скобки
+        drain();
+        std::lock_guard<std::mutex> lock(drainMutex_);
+        if (!traceFile_) return;
+        fputs("\n]\n", traceFile_);
+        fclose(traceFile_);
+        traceFile_ = nullptr;
+    }
+
+    // Забирает записи всех колец и выводит их. Вызывается фоновым потоком и flushLog
+    void drain() {
+        std::lock_guard<std::mutex> lock(drainMutex_);
+        batch_.clear();
+        {
+            std::lock_guard<std::mutex> ringsLock(ringsMutex_);
+            for (auto& ring : rings_) {
+                size_t tail = ring->tail.load(std::memory_order_relaxed);
+                size_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) {
+                    batch_.push_back(ring->entries[tail % LOG_RING_CAPACITY]);
+                }
+                ring->tail.store(tail, std::memory_order_release);
+            }
+            // Кольца завершившихся потоков удаляются, когда из них всё забрано
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                        [](const std::shared_ptr<ThreadRing>& ring) {
+                                            return ring.use_count() == 1 &&
+                                                   ring->tail.load() == ring->head.load();
+                                        }),
+                         rings_.end());
+        }
+        if (batch_.empty()) return;
+
+        // Кольца разных потоков сливаются в общий порядок по времени
+        std::stable_sort(batch_.begin(), batch_.end(), [](const Entry& a, const Entry& b) {
+            return a.record.timestampUs < b.record.timestampUs;
+        });
+        output_.clear();
+        for (const Entry& entry : batch_) {
+            if (entry.span) {
+                writeSpan(entry);
+            } else if (sink_) {
+                sink_(entry.record);
+            } else {
+                appendLine(entry.record);
+            }
+        }
+        if (!output_.empty()) {
+            fwrite(output_.data(), 1, output_.size(), stderr);
+            fflush(stderr);
+        }
+        if (traceFile_) fflush(traceFile_);
+    }
+
+   private:
+    LogWriter() {
+        std::thread([this] {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(wakeMutex_);
+                    drainCv_.wait_for(lock, std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS));
+                }
+                drain();
+            }
+        }).detach();
+        // Записанное перед выходом из программы не теряется
+        std::atexit([] { LogWriter::instance().drain(); });
+    }
+
+    std::shared_ptr<ThreadRing> registerRing() {
+        auto ring = std::make_shared<ThreadRing>();
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        ring->threadId = nextThreadId_++;
+        rings_.push_back(ring);
+        return ring;
+    }
+
+    void appendLine(const LogRecord& record) {
+        time_t seconds = record.timestampUs / 1000000;
+        tm local;
+        localtime_r(&seconds, &local);
+        char prefix[64];
+        int len = snprintf(prefix, sizeof(prefix), "[%02d:%02d:%02d.%03d] %-5s [%u] ",
+                           local.tm_hour, local.tm_min, local.tm_sec,
+                           static_cast<int>(record.timestampUs / 1000 % 1000),
+                           levelName(record.level), record.threadId);
+        output_.append(prefix, std::max(0, len));
+        output_.append(record.message);
+        output_.push_back('\n');
+    }
+
+    void writeSpan(const Entry& entry) {
+        if (!traceFile_) return;
+        fprintf(traceFile_,
+                "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,"
+                "\"pid\":%d,\"tid\":%u,\"args\":{\"id\":%llu}}",
+                firstSpan_ ? "" : ",\n", entry.name, entry.category,
+                static_cast<long long>(entry.startUs), static_cast<long long>(entry.durationUs),
+                static_cast<int>(getpid()), entry.record.threadId,
+                static_cast<unsigned long long>(entry.id));
+        firstSpan_ = false;
+    }
+
+    std::mutex ringsMutex_;
+    std::vector<std::shared_ptr<ThreadRing>> rings_;
+    uint32_t nextThreadId_ = 1;
+
+    // Вывод: приёмник, файл трассировки и буферы прохода защищены drainMutex_
+    std::mutex drainMutex_;
+    LogSink sink_;
+    FILE* traceFile_ = nullptr;
+    bool firstSpan_ = true;
+    std::vector<Entry> batch_;
+    std::string output_;
+
+    std::mutex wakeMutex_;
+    std::condition_variable drainCv_;
+    std::atomic<int> rateLimit_{DEFAULT_LOG_RATE_LIMIT};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+}  // namespace
+
+void setLogLevel(LogLevel level) {
+    detail::logLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel getLogLevel() {
+    return static_cast<LogLevel>(detail::logLevel.load(std::memory_order_relaxed));
+}
+
+void setLogRateLimit(int recordsPerSecond) {
+    LogWriter::instance().setRateLimit(std::max(0, recordsPerSecond));
+}
+
+void setLogSink(LogSink sink) { LogWriter::instance().setSink(std::move(sink)); }
+
+uint64_t droppedLogRecords() { return LogWriter::instance().dropped(); }
+
+void flushLog() { LogWriter::instance().drain(); }
+
+bool startTrace(const std::string& path) { return LogWriter::instance().startTrace(path); }
+
+void stopTrace() { LogWriter::instance().stopTrace(); }
+
+namespace detail {
+
+void write(LogLevel level, LogSite& site, const char* format, ...) {
+    LogWriter& writer = LogWriter::instance();
+
+    // Не больше rateLimit записей за окно с одного места; пропущенные упоминаются
+    // в первой записи следующего окна
+    uint32_t suppressed = 0;
+    const int limit = writer.rateLimit();
+    if (limit > 0) {
+        int64_t now = steadyUs(std::chrono::steady_clock::now());
+        int64_t windowStart = site.windowStartUs.load(std::memory_order_relaxed);
+        if (now - windowStart >= LOG_RATE_WINDOW_US &&
+            site.windowStartUs.compare_exchange_strong(windowStart, now,
+                                                       std::memory_order_relaxed)) {
+            site.count.store(0, std::memory_order_relaxed);
+        }
+        if (site.count.fetch_add(1, std::memory_order_relaxed) >= static_cast<uint32_t>(limit)) {
+            site.suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    ThreadRing* ring = writer.localRing();
+    Entry* entry = ring->reserve();
+    if (!entry) {
+        writer.countDropped();
+        return;
+    }
+    entry->span = false;
+    entry->record.level = level;
+    entry->record.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::system_clock::now().time_since_epoch())
+                                    .count();
+    entry->record.threadId = ring->threadId;
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(entry->record.message, LOG_MESSAGE_SIZE, format, args);
+    va_end(args);
+    if (suppressed > 0 && len >= 0 && static_cast<size_t>(len) < LOG_MESSAGE_SIZE) {
+        snprintf(entry->record.message + len, LOG_MESSAGE_SIZE - len,
+                 " (%u similar messages suppressed)", suppressed);
+    }
+    ring->commit();
+
+    if (level >= LogLevel::Error) writer.wake();
+}
+
+void writeSpan(const char* name, const char* category,
+               std::chrono::steady_clock::time_point start,
+               std::chrono::steady_clock::time_point end, uint64_t id) {
+    LogWriter& writer = LogWriter::instance();
+    ThreadRing* ring = writer.localRing();
+    Entry* entry = ring->reserve();
+    if (!entry) {
+        writer.countDropped();
+        return;
+    }
+    entry->span = true;
+    entry->name = name;
+    entry->category = category;
+    entry->startUs = steadyUs(start);
+    entry->durationUs = std::max<int64_t>(0, steadyUs(end) - steadyUs(start));
+    entry->id = id;
+    entry->record.threadId = ring->threadId;
+    // Порядок вывода общий со строками журнала, поэтому время - по system_clock
+    entry->record.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::system_clock::now().time_since_epoch())
+                                    .count();
+    ring->commit();
+}
+
+}  // namespace detail
+
+}  // namespace MulticastLib
@@ -0,0 +1,329 @@
+#include "loopback_transport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <thread>
+
+// Ёмкость очереди управляющих сообщений Sender'у
+#define LOOPBACK_CONTROL_CAPACITY 1024
+// Ожидание датаграмм: сначала столько раз уступаем процессор, потом спим короткими
+// отрезками, чтобы не пропустить срок отложенной доставки
+#define LOOPBACK_YIELD_SPINS 64
+#define LOOPBACK_SLEEP_US 50
+
+namespace MulticastLib {
+
+namespace {
+
+void backoff(int spins) {
+    if (spins < LOOPBACK_YIELD_SPINS) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(LOOPBACK_SLEEP_US));
+    }
+}
+
+// Копирует len байт из data в iovec'и сообщения; false - не поместилось
+bool scatter(msghdr& msg, const uint8_t* data, size_t len, size_t* copied) {
+    size_t offset = 0;
+    for (size_t i = 0; i < msg.msg_iovlen && offset < len; ++i) {
+        size_t part = std::min(msg.msg_iov[i].iov_len, len - offset);
+        memcpy(msg.msg_iov[i].iov_base, data + offset, part);
+        offset += part;
+    }
+    *copied = offset;
+    return offset == len;
+}
+
+}  // namespace
+
+class LoopbackSenderTransport : public SenderTransport {
+   public:
+    explicit LoopbackSenderTransport(std::shared_ptr<LoopbackNetwork> network)
+        : network_(std::move(network)) {}
+    ~LoopbackSenderTransport() override { close(); }
+
+    bool open(std::chrono::microseconds controlTimeout) override {
+        controlTimeout_ = controlTimeout;
+        network_->senderOpen_.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void close() override {
+        network_->senderOpen_.store(false, std::memory_order_release);
+        std::string stale;
+        while (network_->control_.tryPop(stale)) {
+        }
+    }
+
+    int sendBatch(struct mmsghdr* messages, unsigned int count) override {
+        LoopbackNetwork& net = *network_;
+        auto endpoints = net.endpoints();
+        auto now = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < count; ++i) {
+            msghdr& msg = messages[i].msg_hdr;
+            size_t len = 0;
+            for (size_t k = 0; k < msg.msg_iovlen; ++k) len += msg.msg_iov[k].iov_len;
+            messages[i].msg_len = static_cast<unsigned int>(len);
+
+            // Как у UDP: отправка удаётся, даже если датаграмму никто не получит
+            if (len > net.slotSize_) {
+                net.packetsOversized_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (endpoints->empty()) continue;
+            LoopbackNetwork::Packet* packet;
+            if (!net.freePackets_.tryPop(packet)) {
+                net.packetsOverflowed_.fetch_add(endpoints->size(), std::memory_order_relaxed);
+                continue;
+            }
+
+            // Одна копия на датаграмму, приёмники делят буфер по счётчику ссылок
+            size_t offset = 0;
+            for (size_t k = 0; k < msg.msg_iovlen; ++k) {
+                memcpy(packet->data + offset, msg.msg_iov[k].iov_base, msg.msg_iov[k].iov_len);
+                offset += msg.msg_iov[k].iov_len;
+            }
+            packet->len = len;
+            packet->sentAt = now;
+            packet->refs.store(static_cast<int>(endpoints->size()), std::memory_order_relaxed);
+            for (const auto& endpoint : *endpoints) {
+                LoopbackNetwork::Packet* item = packet;
+                if (!endpoint->queue.tryPush(std::move(item))) {
+                    net.packetsOverflowed_.fetch_add(1, std::memory_order_relaxed);
+                    net.release(packet);
+                }
+            }
+        }
+        net.packetsSent_.fetch_add(count, std::memory_order_relaxed);
+        return static_cast<int>(count);
+    }
+
+    int receiveControl(struct mmsghdr* messages, unsigned int count) override {
+        auto deadline = std::chrono::steady_clock::now() + controlTimeout_;
+        unsigned int received = 0;
+        std::string message;
+        for (int spins = 0;; ++spins) {
+            while (received < count && network_->control_.tryPop(message)) {
+                size_t copied;
+                msghdr& msg = messages[received].msg_hdr;
+                msg.msg_flags = scatter(msg, reinterpret_cast<const uint8_t*>(message.data()),
+                                        message.size(), &copied)
+                                    ? 0
+                                    : MSG_TRUNC;
+                messages[received++].msg_len = static_cast<unsigned int>(copied);
+            }
+            if (received > 0) return static_cast<int>(received);
+            if (std::chrono::steady_clock::now() >= deadline) return 0;
+            backoff(spins);
+        }
+    }
+
+   private:
+    std::shared_ptr<LoopbackNetwork> network_;
+    std::chrono::microseconds controlTimeout_{0};
+};
+
+class LoopbackReceiverTransport : public ReceiverTransport {
+   public:
+    LoopbackReceiverTransport(std::shared_ptr<LoopbackNetwork> network, uint64_t seed)
+        : network_(std::move(network)), random_(seed) {}
+    ~LoopbackReceiverTransport() override { close(); }
+
+    bool open(std::chrono::microseconds receiveTimeout) override {
+        close();
+        receiveTimeout_ = receiveTimeout;
+        woken_.store(false, std::memory_order_relaxed);
+        endpoint_ = std::make_shared<LoopbackNetwork::Endpoint>(
+            network_.get(), static_cast<size_t>(network_->config_.capacity));
+        network_->join(endpoint_);
+        return true;
+    }
+
+    void close() override {
+        if (!endpoint_) return;
+        network_->leave(endpoint_);
+        // Очередь освободит Endpoint, когда отпустят последний снимок списка
+        endpoint_.reset();
+        for (const Pending& pending : pending_) network_->release(pending.packet);
+        pending_.clear();
+    }
+
+    void wake() override { woken_.store(true, std::memory_order_release); }
+
+    int receiveBatch(struct mmsghdr* messages, unsigned int count) override {
+        if (!endpoint_) {
+            errno = EBADF;
+            return -1;
+        }
+        auto deadline = std::chrono::steady_clock::now() + receiveTimeout_;
+        for (int spins = 0;; ++spins) {
+            LoopbackNetwork::Packet* packet;
+            while (endpoint_->queue.tryPop(packet)) admit(packet);
+
+            // Отдаём датаграммы, срок доставки которых наступил, в порядке сроков
+            auto now = std::chrono::steady_clock::now();
+            unsigned int delivered = 0;
+            while (delivered < count && !pending_.empty() && pending_.front().deliverAt <= now) {
+                std::pop_heap(pending_.begin(), pending_.end(), Later());
+                Pending next = pending_.back();
+                pending_.pop_back();
+
+                size_t copied;
+                msghdr& msg = messages[delivered].msg_hdr;
+                msg.msg_flags = scatter(msg, next.packet->data, next.packet->len, &copied)
+                                    ? 0
+                                    : MSG_TRUNC;
+                messages[delivered++].msg_len = static_cast<unsigned int>(copied);
+                network_->release(next.packet);
+            }
+            if (delivered > 0) {
+                network_->packetsDelivered_.fetch_add(delivered, std::memory_order_relaxed);
+                return static_cast<int>(delivered);
+            }
+
+            // Как у сокета: 0 после остановки, EAGAIN по таймауту
+            if (woken_.load(std::memory_order_acquire)) return 0;
+            if (now >= deadline) {
+                errno = EAGAIN;
+                return -1;
+            }
+            backoff(spins);
+        }
+    }
+
+    bool sendControl(const void* data, size_t len) override {
+        if (!network_->senderOpen_.load(std::memory_order_acquire)) return false;
+        std::string message(static_cast<const char*>(data), len);
+        if (!network_->control_.tryPush(std::move(message))) return false;
+        network_->controlMessages_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+   private:
+    // Датаграмма, ждущая срока доставки; куча упорядочена по сроку, при равных - по
+    // порядку поступления
+    struct Pending {
+        std::chrono::steady_clock::time_point deliverAt;
+        uint64_t order;
+        LoopbackNetwork::Packet* packet;
+    };
+
+    struct Later {
+        bool operator()(const Pending& a, const Pending& b) const {
+            return a.deliverAt != b.deliverAt ? a.deliverAt > b.deliverAt : a.order > b.order;
+        }
+    };
+
+    bool chance(double ratio) { return ratio > 0 && uniform_(random_) < ratio; }
+
+    // Искажения канала решаются при поступлении датаграммы в этот приёмник
+    void admit(LoopbackNetwork::Packet* packet) {
+        const LoopbackConfig& config = network_->config_;
+        if (chance(config.lossRatio)) {
+            network_->packetsLost_.fetch_add(1, std::memory_order_relaxed);
+            network_->release(packet);
+            return;
+        }
+        int copies = 1;
+        if (chance(config.duplicateRatio)) {
+            packet->refs.fetch_add(1, std::memory_order_relaxed);
+            network_->packetsDuplicated_.fetch_add(1, std::memory_order_relaxed);
+            copies = 2;
+        }
+        for (int i = 0; i < copies; ++i) {
+            int64_t delayUs = config.delayUs;
+            if (config.jitterUs > 0) delayUs += random_() % (config.jitterUs + 1);
+            if (chance(config.reorderRatio)) delayUs += config.reorderDelayUs;
+            pending_.push_back(
+                {packet->sentAt + std::chrono::microseconds(delayUs), nextOrder_++, packet});
+            std::push_heap(pending_.begin(), pending_.end(), Later());
+        }
+    }
+
+    std::shared_ptr<LoopbackNetwork> network_;
+    std::shared_ptr<LoopbackNetwork::Endpoint> endpoint_;
+    std::chrono::microseconds receiveTimeout_{0};
+    std::atomic<bool> woken_{false};
+    std::vector<Pending> pending_;
+    uint64_t nextOrder_ = 0;
+    std::mt19937_64 random_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+};
+
+LoopbackNetwork::LoopbackNetwork(const LoopbackConfig& config)
+    : config_(config),
+      slotSize_(std::clamp<size_t>(config.mtu, MIN_MTU, MAX_MTU) - IPV4_UDP_OVERHEAD),
+      freePackets_(std::max(1, config.capacity)),
+      endpoints_(std::make_shared<const EndpointList>()),
+      control_(LOOPBACK_CONTROL_CAPACITY) {
+    config_.capacity = std::max(1, config_.capacity);
+    storage_.resize(config_.capacity * slotSize_);
+    packets_.reset(new Packet[config_.capacity]);
+    for (int i = 0; i < config_.capacity; ++i) {
+        Packet* packet = &packets_[i];
+        packet->data = storage_.data() + i * slotSize_;
+        freePackets_.tryPush(std::move(packet));
+    }
+}
+
+LoopbackNetwork::~LoopbackNetwork() = default;
+
+std::unique_ptr<SenderTransport> LoopbackNetwork::createSenderTransport() {
+    return std::make_unique<LoopbackSenderTransport>(shared_from_this());
+}
+
+std::unique_ptr<ReceiverTransport> LoopbackNetwork::createReceiverTransport() {
+    uint64_t index = nextEndpointIndex_.fetch_add(1, std::memory_order_relaxed);
+    return std::make_unique<LoopbackReceiverTransport>(shared_from_this(), config_.seed + index);
+}
+
+LoopbackStatistics LoopbackNetwork::getStatistics() const {
+    LoopbackStatistics stats;
+    stats.packetsSent = packetsSent_.load(std::memory_order_relaxed);
+    stats.packetsDelivered = packetsDelivered_.load(std::memory_order_relaxed);
+    stats.packetsLost = packetsLost_.load(std::memory_order_relaxed);
+    stats.packetsOverflowed = packetsOverflowed_.load(std::memory_order_relaxed);
+    stats.packetsOversized = packetsOversized_.load(std::memory_order_relaxed);
+    stats.packetsDuplicated = packetsDuplicated_.load(std::memory_order_relaxed);
+    stats.controlMessages = controlMessages_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::shared_ptr<const LoopbackNetwork::EndpointList> LoopbackNetwork::endpoints() const {
+    return std::atomic_load_explicit(&endpoints_, std::memory_order_acquire);
+}
+
+void LoopbackNetwork::join(const std::shared_ptr<Endpoint>& endpoint) {
+    std::lock_guard<std::mutex> lock(endpointsMutex_);
+    auto list = std::make_shared<EndpointList>(*endpoints_);
+    list->push_back(endpoint);
+    std::atomic_store_explicit(&endpoints_, std::shared_ptr<const EndpointList>(std::move(list)),
+                               std::memory_order_release);
+}
+
+void LoopbackNetwork::leave(const std::shared_ptr<Endpoint>& endpoint) {
+    std::lock_guard<std::mutex> lock(endpointsMutex_);
+    auto list = std::make_shared<EndpointList>(*endpoints_);
+    list->erase(std::remove(list->begin(), list->end(), endpoint), list->end());
+    std::atomic_store_explicit(&endpoints_, std::shared_ptr<const EndpointList>(std::move(list)),
+                               std::memory_order_release);
+}
+
+void LoopbackNetwork::release(Packet* packet) {
+    if (packet->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        freePackets_.tryPush(std::move(packet));
+    }
+}
+
+LoopbackNetwork::Endpoint::Endpoint(LoopbackNetwork* network, size_t capacity)
+    : network(network), queue(capacity) {}
+
+LoopbackNetwork::Endpoint::~Endpoint() {
+    Packet* packet;
+    while (queue.tryPop(packet)) network->release(packet);
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,75 @@
+#include "protocol.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace MulticastLib {
+
+bool parseChunkHeader(const uint8_t* packet, size_t len, ChunkInfo* info) {
+    // Короткая датаграмма дополняется нулями и отсекается общей проверкой длины
+    ChunkHeader header{};
+    memcpy(&header, packet, std::min(len, sizeof(header)));
+
+    const uint64_t headerLen = header.header_len;
+    const uint64_t frameSize = ntohl(header.frame_size);
+    const uint64_t offset = ntohl(header.payload_offset);
+    const uint64_t payloadLen = ntohs(header.payload_len);
+    const uint64_t index = ntohs(header.chunk_index);
+    const uint64_t total = ntohs(header.total_chunks);
+    const uint64_t chunkSize = ntohs(header.chunk_size);
+    const uint64_t group = header.fec_group;
+    const bool parity = header.flags & CHUNK_FLAG_PARITY;
+
+    // Проверки складываются через &, а не &&: ни одна не пропускается
+    bool common = (len >= CHUNK_HEADER_MIN_LEN) & (header.version == PROTOCOL_VERSION) &
+                  ((header.flags & ~CHUNK_FLAGS_KNOWN) == 0) &
+                  (headerLen >= CHUNK_HEADER_MIN_LEN) & (headerLen + payloadLen == len) &
+                  (chunkSize >= MIN_CHUNK_SIZE) & (chunkSize <= MAX_CHUNK_SIZE) & (total >= 1) &
+                  (frameSize > (total - 1) * chunkSize) & (frameSize <= total * chunkSize) &
+                  (offset == index * chunkSize);
+
+    // Чанк данных лежит внутри кадра, короче chunk_size может быть только последний
+    bool data = (index < total) & (payloadLen == std::min(chunkSize, frameSize - offset));
+
+    // Пакет чётности: группа внутри кадра, нагрузка ровно chunk_size
+    const uint64_t divisor = group + (group == 0);
+    bool fec = (group >= 1) & (index < (total + divisor - 1) / divisor) &
+               (payloadLen == chunkSize);
+
+    info->headerLen = header.header_len;
+    info->flags = header.flags;
+    info->fecGroup = header.fec_group;
+    info->frameSeq = ntohl(header.frame_seq);
+    info->captureTimestampUs = be64toh(header.capture_ts_us);
+    info->frameSize = static_cast<uint32_t>(frameSize);
+    info->payloadLen = static_cast<uint16_t>(payloadLen);
+    info->chunkIndex = static_cast<uint16_t>(index);
+    info->totalChunks = static_cast<uint16_t>(total);
+    info->chunkSize = static_cast<uint16_t>(chunkSize);
+    // Без расширения на месте задержек лежит полезная нагрузка
+    const bool extended = headerLen >= sizeof(ChunkHeader);
+    info->encodeDelayUs = extended ? ntohl(header.encode_delay_us) : 0;
+    info->sendDelayUs = extended ? ntohl(header.send_delay_us) : 0;
+    return common & ((parity & fec) | (!parity & data));
+}
+
+void appendSegment(std::vector<uint8_t>& out, SegmentHeader header, const uint8_t* jpeg,
+                   size_t jpegSize) {
+    header.x = htons(header.x);
+    header.y = htons(header.y);
+    header.width = htons(header.width);
+    header.height = htons(header.height);
+    header.frame_width = htons(header.frame_width);
+    header.frame_height = htons(header.frame_height);
+    header.jpeg_size = htonl(static_cast<uint32_t>(jpegSize));
+
+    size_t offset = out.size();
+    out.resize(offset + sizeof(header) + jpegSize);
+    memcpy(out.data() + offset, &header, sizeof(header));
+    memcpy(out.data() + offset + sizeof(header), jpeg, jpegSize);
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,87 @@
+#include "rate_controller.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace MulticastLib {
+
+namespace {
+
+const double kScaleLadder[] = {1.0, 0.75, 0.5, 0.25};
+const int kScaleSteps = static_cast<int>(std::size(kScaleLadder));
+
+const int kMinQuality = 30;
+const int kQualityStepUp = 5;
+const double kMinFps = 5.0;
+const double kFpsFactor = 0.75;
+
+// Битрейт считается превышенным выше 105% цели, запас - ниже 80%
+const double kOverTarget = 1.05;
+const double kUnderTarget = 0.8;
+
+}  // namespace
+
+RateController::RateController(int targetBitrateKbps, double lossThreshold, int maxQuality,
+                               double maxFps)
+    : lossThreshold_(lossThreshold), maxQuality_(maxQuality), maxFps_(maxFps) {
+    point_.jpegQuality = maxQuality;
+    point_.fps = maxFps;
+    point_.targetBitrateKbps = targetBitrateKbps;
+}
+
+const OperatingPoint& RateController::update(double measuredBitrateKbps, double worstLossRatio) {
+    point_.measuredBitrateKbps = measuredBitrateKbps;
+    point_.worstLossRatio = worstLossRatio;
+    // Без цели адаптация выключена, потери тоже не учитываются: кодер работает на
+    // максимуме, а не там, где его оставила последняя ступень
+    if (!enabled()) {
+        reset();
+        return point_;
+    }
+
+    double target = point_.targetBitrateKbps;
+    if (worstLossRatio > lossThreshold_) {
+        // Потери - резкое снижение, пропорциональное их доле
+        stepDown(worstLossRatio > 2 * lossThreshold_ ? 15 : 10);
+    } else if (measuredBitrateKbps > target * kOverTarget) {
+        stepDown(5);
+    } else if (measuredBitrateKbps < target * kUnderTarget &&
+               worstLossRatio < lossThreshold_ / 2) {
+        stepUp();
+    }
+    return point_;
+}
+
+void RateController::setTargetBitrate(int kbps) {
+    point_.targetBitrateKbps = kbps;
+    if (!enabled()) reset();
+}
+
+void RateController::reset() {
+    scaleIndex_ = 0;
+    point_.scale = kScaleLadder[0];
+    point_.jpegQuality = maxQuality_;
+    point_.fps = maxFps_;
+}
+
+void RateController::stepDown(int qualityStep) {
+    if (point_.jpegQuality > kMinQuality) {
+        point_.jpegQuality = std::max(kMinQuality, point_.jpegQuality - qualityStep);
+    } else if (scaleIndex_ + 1 < kScaleSteps) {
+        point_.scale = kScaleLadder[++scaleIndex_];
+    } else {
+        point_.fps = std::max(kMinFps, point_.fps * kFpsFactor);
+    }
+}
+
+void RateController::stepUp() {
+    if (point_.fps < maxFps_) {
+        point_.fps = std::min(maxFps_, point_.fps / kFpsFactor);
+    } else if (scaleIndex_ > 0) {
+        point_.scale = kScaleLadder[--scaleIndex_];
+    } else {
+        point_.jpegQuality = std::min(maxQuality_, point_.jpegQuality + kQualityStepUp);
+    }
+}
+
+}  // namespace MulticastLib
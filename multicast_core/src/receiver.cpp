@@ -1,223 +1,664 @@
 #include "receiver.h"
 
-#include <arpa/inet.h>
-#include <unistd.h>
-
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iomanip>
-#include <iostream>
 #include <random>
+#include <sstream>
+
+#include "logging.h"
 
 #define LISTENING_TIMEOUT_S 3
+// С NACK'ами приём просыпается чаще, чтобы запросить хвост кадра, не дожидаясь следующего
+#define NACK_POLL_INTERVAL_US 5000
+// Сколько кадров можно запросить за один проход
+#define MAX_NACKS_PER_POLL 8
+// Сколько недособранных кадров можно отдать на декодирование за один проход
+#define MAX_PARTIAL_PER_POLL 8
+// Окно, по которому считаются потери и FPS для heartbeat'а
+#define FEEDBACK_WINDOW_S 1.0
+// Окно windowFps в статистике
+#define FPS_WINDOW_S 1.0
+// Кадров в пуле публикации сверх числа потоков декодирования - их удерживают читатели
+#define FRAME_POOL_EXTRA 4
+// Как часто поток обработчиков кадров проверяет, не остановлен ли приём
+#define CALLBACK_POLL_INTERVAL_MS 100
 namespace MulticastLib {
 
 Receiver::Receiver(const std::string& multicastIP, int port)
-    : multicastIP_(multicastIP), port_(port), isReceiving_(false), sockfd_(-1), data_received(0) {
+    : Receiver(multicastIP, port, ReceiverConfig()) {}
+
+Receiver::Receiver(const std::string& multicastIP, int port, const ReceiverConfig& config)
+    : multicastIP_(multicastIP),
+      port_(port),
+      config_(config),
+      transport_(makeUdpReceiverTransport(multicastIP, port, config.socketRecvBufferSize,
+                                          config.ioBackend, config.receiveOffload)),
+      isReceiving_(false),
+      assembler_(std::max(1, config.frameSlotCount),
+                 std::max(config.maxFrameSize, static_cast<int>(MIN_CHUNK_SIZE))),
+      decodeQueue_(std::max(1, config.decodeQueueCapacity)),
+      framePool_(std::max(1, config.decodeThreads) + FRAME_POOL_EXTRA),
+      encodedFramePool_(std::max(1, config.decodeThreads) + FRAME_POOL_EXTRA),
+      decodeEnabled_(config.decodeFrames) {
+    config_.recvBatchSize = std::max(1, config_.recvBatchSize);
+    config_.decodeThreads = std::max(1, config_.decodeThreads);
+    // Слот должен вмещать датаграмму при MTU Sender'а, иначе пакеты будут обрезаны
+    config_.packetSlotSize = std::max(
+        config_.packetSlotSize, static_cast<int>(DEFAULT_MTU - IPV4_UDP_OVERHEAD));
     receiverID_ = generateClientID();
-    std::cout << "Receiver ID: " << receiverID_ << std::endl;
-}
-
-Receiver::~Receiver() {
-    stop();
-    if (sockfd_ != -1) close(sockfd_);
+    MULTICAST_LOG_INFO("Receiver ID: %s", receiverID_.c_str());
 }
 
-bool Receiver::setupSocket() {
-    sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd_ < 0) {
-        perror("socket failed");
-        return false;
-    }
-
-    struct timeval tv{.tv_sec = LISTENING_TIMEOUT_S, .tv_usec = 0};
+Receiver::~Receiver() { stop(); }
 
-    if (setsockopt(sockfd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-        perror("setsockopt SO_RCVTIMEO failed");
-        close(sockfd_);
-        return false;
-    }
-
-    int reuse = 1;
-    if (setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0) {
-        perror("setsockopt SO_REUSEADDR failed");
-        return false;
-    }
-
-    if (setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
-        perror("setsockopt SO_REUSEPORT failed");
-        return false;
-    }
-
-    memset(&localAddr_, 0, sizeof(localAddr_));
-    localAddr_.sin_family = AF_INET;
-    localAddr_.sin_addr.s_addr = htonl(INADDR_ANY);
-    localAddr_.sin_port = htons(port_);
-
-    if (bind(sockfd_, (struct sockaddr*)&localAddr_, sizeof(localAddr_)) < 0) {
-        perror("bind failed");
-        return false;
-    }
-
-    mreq_.imr_multiaddr.s_addr = inet_addr(multicastIP_.c_str());
-    mreq_.imr_interface.s_addr = htonl(INADDR_ANY);
-    if (setsockopt(sockfd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq_, sizeof(mreq_)) < 0) {
-        perror("setsockopt IP_ADD_MEMBERSHIP failed");
-        return false;
+bool Receiver::openTransport() {
+    // Таймаут ожидания датаграмм, см. NACK_POLL_INTERVAL_US
+    std::chrono::microseconds timeout = std::chrono::seconds(LISTENING_TIMEOUT_S);
+    if (config_.enableNack || config_.decodePartialFrames) {
+        timeout = std::chrono::microseconds(NACK_POLL_INTERVAL_US);
     }
+    hasSenderAddr_ = false;
+    lastHeartbeatTime_ = {};
+    return transport_->open(timeout);
+}
 
+bool Receiver::setTransport(std::unique_ptr<ReceiverTransport> transport) {
+    if (isReceiving_ || !transport) return false;
+    transport_ = std::move(transport);
     return true;
 }
 
 bool Receiver::start() {
     if (isReceiving_) return false;
-    if (!setupSocket()) return false;
+    // Потоки прошлой сессии могли завершиться сами по таймауту потока данных
+    stop();
+    if (!openTransport()) return false;
 
     isReceiving_ = true;
+    for (int i = 0; i < config_.decodeThreads; ++i) {
+        decodeThreads_.emplace_back(&Receiver::decodeLoop, this);
+    }
     receiveThread_ = std::thread(&Receiver::receiveLoop, this);
+    callbackThread_ = std::thread(&Receiver::callbackLoop, this);
     return true;
 }
 
 void Receiver::stop() {
     isReceiving_ = false;
-    {
-        std::lock_guard<std::mutex> lock(frameMutex_);
-        lastFrame_ = cv::Mat();
-    }
-    if (sockfd_ != -1) {
-        close(sockfd_);
-    }
+    transport_->wake();
+    notifyFrameWaiters();
 
     if (receiveThread_.joinable()) receiveThread_.join();
+    if (callbackThread_.joinable()) callbackThread_.join();
+    for (auto& thread : decodeThreads_) {
+        if (thread.joinable()) thread.join();
+    }
+    decodeThreads_.clear();
+
+    // Недекодированные кадры возвращаем в пул сборщика
+    CompletedFrame pending;
+    while (decodeQueue_.tryPop(pending)) assembler_.release(pending.slot);
+
+    transport_->close();
+
+    std::lock_guard<std::mutex> lock(frameMutex_);
+    latestFrame_.publish(nullptr);
+    latestEncodedFrame_.publish(nullptr);
+    lastEncodedSequence_ = 0;
+    hasFrame_ = false;
+    canvas_ = cv::Mat();
+    canvasPublished_ = false;
+    segmentSequence_.clear();
+    pickedUpSequence_ = 0;
 }
 
 bool Receiver::receiveLoop() {
-    std::vector<uint8_t> buffer(65507);
+    const size_t batch = config_.recvBatchSize;
+    const size_t slot = config_.packetSlotSize;
+
+    // Кольцо и заголовки сообщений выделяются один раз на сессию приёма
+    rxRing_.resize(batch * slot);
+    rxIovecs_.resize(batch);
+    rxMessages_.resize(batch);
+
     auto lastPacketTime = std::chrono::steady_clock::now();
+    const auto heartbeatInterval = std::chrono::milliseconds(config_.heartbeatIntervalMs);
     while (isReceiving_) {
-        sockaddr_in senderAddr{};
-        socklen_t addrLen = sizeof(senderAddr);
-        ssize_t recvLen =
-            recvfrom(sockfd_, buffer.data(), buffer.size(), 0, (sockaddr*)&senderAddr, &addrLen);
-
-        if (recvLen > 0) {
-            processPacket(buffer, recvLen);
-
-            if (sendHeartbeat(senderAddr)) {
-                std::cout << "Heartbeat sent to " << inet_ntoa(senderAddr.sin_addr) << std::endl;
-            } else {
-                std::cerr << "Failed to send heartbeat" << std::endl;
+        for (size_t i = 0; i < batch; ++i) {
+            rxIovecs_[i] = {rxRing_.data() + i * slot, slot};
+            msghdr& msg = rxMessages_[i].msg_hdr;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &rxIovecs_[i];
+            msg.msg_iovlen = 1;
+        }
+
+        // Блокируемся до первой датаграммы, остальное забираем без ожидания
+        int received = transport_->receiveBatch(rxMessages_.data(), batch);
+
+        if (received > 0) {
+            // Счётчики копятся за пачку и публикуются разом, без блокировки на пакет
+            uint64_t corrupted = 0;
+            for (int i = 0; i < received; ++i) {
+                if (rxMessages_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    corrupted++;
+                    continue;
+                }
+                // Транспорт мог отдать датаграмму в своём буфере, а не в слоте кольца
+                if (!processPacket(static_cast<const uint8_t*>(rxIovecs_[i].iov_base),
+                                   rxMessages_[i].msg_len)) {
+                    corrupted++;
+                }
             }
+            // Единственный писатель - этот поток, RMW-инструкция не нужна
+            packetsReceived_.store(packetsReceived_.load(std::memory_order_relaxed) + received,
+                                   std::memory_order_relaxed);
+            if (corrupted) {
+                corruptedPackets_.store(
+                    corruptedPackets_.load(std::memory_order_relaxed) + corrupted,
+                    std::memory_order_relaxed);
+            }
+
+            hasSenderAddr_ = true;
             cleanupExpiredFrames();
             lastPacketTime = std::chrono::steady_clock::now();
         } else {
             auto now = std::chrono::steady_clock::now();
             auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - lastPacketTime);
             if (elapsed.count() >= LISTENING_TIMEOUT_S) {
-                std::cout << "Stream is not available" << std::endl;
+                MULTICAST_LOG_WARNING("Stream is not available");
                 isReceiving_ = false;
+                notifyFrameWaiters();
             }
         }
+
+        // Heartbeat не чаще раза в heartbeatIntervalMs, а не на каждую пачку пакетов
+        auto now = std::chrono::steady_clock::now();
+        if (hasSenderAddr_ && now - lastHeartbeatTime_ >= heartbeatInterval) {
+            lastHeartbeatTime_ = now;
+            if (!sendHeartbeat()) MULTICAST_LOG_WARNING("Failed to send heartbeat");
+        }
+        if (config_.enableNack) sendNacks();
+        if (config_.decodePartialFrames) collectPartialFrames();
     }
     return false;
 }
 
-void Receiver::processPacket(const std::vector<uint8_t>& buffer, ssize_t recvLen) {
-    {
-        std::lock_guard<std::mutex> lock(statsMutex_);
-        stats_.totalPacketsReceived++;
+bool Receiver::processPacket(const uint8_t* data, size_t len) {
+    ChunkInfo info;
+    if (!parseChunkHeader(data, len, &info)) return false;
+
+    // Поля, дописанные в заголовок более новыми версиями, пропускаются по header_len
+    const uint8_t* payload = data + info.headerLen;
+    CompletedFrame completed;
+    FrameAssembler::Result result = (info.flags & CHUNK_FLAG_PARITY)
+                                        ? assembler_.addParity(info, payload, &completed)
+                                        : assembler_.addChunk(info, payload, &completed);
+    if (result == FrameAssembler::Result::Rejected) return false;
+    recoveredChunks_.store(assembler_.recoveredChunks(), std::memory_order_relaxed);
+    if (result != FrameAssembler::Result::Completed) return true;
+    framesCompleted_++;
+
+    MULTICAST_LOG_DEBUG("Received %zu bytes in %u chunks", completed.size,
+                        static_cast<unsigned>(completed.totalChunks));
+    enqueueForDecode(completed);
+    return true;
+}
+
+void Receiver::enqueueForDecode(const CompletedFrame& frame) {
+    // Задержки Sender'а нулевые, если он не прислал расширение заголовка
+    if (frame.sendDelayUs > 0) {
+        captureToEncodeLatency_.record(frame.encodeDelayUs);
+        captureToSendLatency_.record(frame.sendDelayUs);
     }
+    reassemblyLatency_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                  frame.lastPacketTime - frame.firstPacketTime)
+                                  .count());
+    traceSpan("reassemble", "receiver", frame.firstPacketTime, frame.lastPacketTime,
+              frame.captureTimestampUs);
+
+    // Декодеры не успевают - выбрасываем самый старый ожидающий кадр
+    CompletedFrame item = frame;
+    while (!decodeQueue_.tryPush(std::move(item))) {
+        CompletedFrame stale;
+        if (decodeQueue_.tryPop(stale)) {
+            assembler_.release(stale.slot);
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.totalStaleFrames++;
+        }
+    }
+}
 
-    if (recvLen < 12) {
-        std::lock_guard<std::mutex> lock(statsMutex_);
-        stats_.totalCorruptedPackets++;
-        return;
+void Receiver::decodeLoop() {
+    // Декодеры, кадр и сегменты у каждого потока свои и переиспользуются между кадрами.
+    // Первый декодер пула работает в самом потоке и декодирует цельные кадры
+    SegmentDecoders segmentDecoders(config_.segmentDecodeThreads);
+    JpegDecoder& decoder = *segmentDecoders.decoders[0];
+    cv::Mat frame;
+    std::vector<DecodedSegment> segments;
+    while (isReceiving_) {
+        CompletedFrame completed;
+        if (!decodeQueue_.popWait(completed, std::chrono::milliseconds(100))) continue;
+
+        // Цельный JPEG сохраняется как есть для раздачи без перекодирования. Буфер
+        // берётся из пула под frameMutex_, копируется уже без него
+        bool segmented = completed.flags & CHUNK_FLAG_SEGMENTED;
+        std::shared_ptr<EncodedVideoFrame> encoded;
+        if (!segmented) {
+            {
+                std::lock_guard<std::mutex> frameLock(frameMutex_);
+                encoded = encodedFramePool_.acquire();
+            }
+            encoded->jpeg.assign(completed.data, completed.data + completed.size);
+            encoded->sequence = completed.sequence;
+            encoded->captureTimestampUs = completed.captureTimestampUs;
+        }
+        const bool decode = segmented || decodeEnabled_.load(std::memory_order_relaxed);
+
+        // Декодируем прямо из буфера слота, без промежуточной склейки
+        auto decodeStart = std::chrono::steady_clock::now();
+        cv::Size frameSize;
+        size_t segmentCount = 0;
+        bool decoded = false;
+        // Кадр из сети: исключение (нехватка памяти, OpenCV) теряет только этот кадр
+        try {
+            if (segmented) {
+                segmentCount = decodeSegments(segmentDecoders, completed, segments, frameSize);
+            } else if (decode && config_.decodeToYuv) {
+                decoded = decoder.decodeYuv(completed.data, completed.size, frame);
+            } else if (decode) {
+                decoded = decoder.decode(completed.data, completed.size, frame);
+            }
+        } catch (const std::exception& e) {
+            MULTICAST_LOG_WARNING("Failed to decode frame %llu: %s",
+                                  static_cast<unsigned long long>(completed.sequence), e.what());
+            segmentCount = 0;
+            decoded = false;
+        }
+        assembler_.release(completed.slot);
+        auto decodeEnd = std::chrono::steady_clock::now();
+        double decodeTimeMs =
+            std::chrono::duration<double, std::milli>(decodeEnd - decodeStart).count();
+        if (decode) {
+            traceSpan("decode", "receiver", decodeStart, decodeEnd, completed.captureTimestampUs);
+        }
+
+        if (segmentCount > 0) {
+            double completeness = double(completed.receivedChunks) / completed.totalChunks;
+            publishSegments(segments, segmentCount, frameSize, completed.sequence,
+                            completed.captureTimestampUs, decodeTimeMs, completeness);
+        } else if (decoded) {
+            publishEncoded(std::move(encoded));
+            publishFrame(frame, completed.sequence, completed.captureTimestampUs, decodeTimeMs);
+        } else if (!decode) {
+            publishEncoded(std::move(encoded));
+            updatePassthroughStatistics();
+        }
     }
+}
 
-    uint8_t frame_id[8];
-    uint16_t chunk_no, total_chunks;
+Receiver::SegmentDecoders::SegmentDecoders(int threadCount) : pool(std::max(1, threadCount)) {
+    for (size_t i = 0; i < pool.size(); ++i) decoders.push_back(std::make_unique<JpegDecoder>());
+}
 
-    memcpy(frame_id, buffer.data(), 8);
-    memcpy(&chunk_no, buffer.data() + 8, 2);
-    memcpy(&total_chunks, buffer.data() + 10, 2);
-    data_received += 12;
-    chunk_no = ntohs(chunk_no);
-    total_chunks = ntohs(total_chunks);
-    std::string fid(reinterpret_cast<char*>(frame_id), 8);
+namespace {
 
+// Все ли чанки, покрывающие байты [begin, end) кадра, пришли
+bool chunksPresent(const CompletedFrame& frame, size_t begin, size_t end) {
+    if (!frame.chunkBitmap) return true;
+    for (size_t chunk = begin / frame.chunkSize; chunk * frame.chunkSize < end; ++chunk) {
+        if (!(frame.chunkBitmap[chunk / 64] & (uint64_t(1) << (chunk % 64)))) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+size_t Receiver::decodeSegments(SegmentDecoders& decoders, const CompletedFrame& frame,
+                                std::vector<DecodedSegment>& segments, cv::Size& frameSize) {
+    // Контейнер: SegmentHeader + JPEG подряд до конца кадра (см. protocol.h).
+    // Сначала разбираются заголовки, затем сегменты декодируются независимо друг от друга
+    const bool partial = frame.chunkBitmap != nullptr;
+    const bool aligned = frame.flags & CHUNK_FLAG_ALIGNED;
+    size_t count = 0;
+    size_t offset = 0;
+    while (offset + sizeof(SegmentHeader) <= frame.size) {
+        const size_t start = offset;
+        SegmentHeader header;
+        memcpy(&header, frame.data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        size_t jpegSize = ntohl(header.jpeg_size);
+        cv::Rect rect(ntohs(header.x), ntohs(header.y), ntohs(header.width),
+                      ntohs(header.height));
+        cv::Size size(ntohs(header.frame_width), ntohs(header.frame_height));
+        bool valid = jpegSize <= frame.size - offset && rect.width > 0 && rect.height > 0 &&
+                     rect.x + rect.width <= size.width && rect.y + rect.height <= size.height &&
+                     (count == 0 || size == frameSize);
+        // В недособранном кадре заголовок мог остаться от прошлого кадра слота, поэтому
+        // сегмент берётся, только если все его чанки пришли и JPEG начинается с SOI
+        if (partial) {
+            valid = valid && jpegSize >= 2 && chunksPresent(frame, start, offset + jpegSize) &&
+                    frame.data[offset] == 0xff && frame.data[offset + 1] == 0xd8;
+        }
+        if (!valid) {
+            // Собранный целиком кадр с битым контейнером отбрасывается. В недособранном
+            // следующий сегмент ищется с границы следующего чанка - так декодер JPEG
+            // после ошибки ищет следующий маркер RST
+            if (!partial) return 0;
+            offset = (start / frame.chunkSize + 1) * frame.chunkSize;
+            continue;
+        }
+        frameSize = size;
+
+        if (count == segments.size()) segments.emplace_back();
+        DecodedSegment& segment = segments[count++];
+        segment.rect = rect;
+        segment.jpeg = frame.data + offset;
+        segment.jpegSize = jpegSize;
+        offset += jpegSize;
+        if (aligned && offset < frame.size) {
+            offset = std::min(frame.size,
+                              (offset + frame.chunkSize - 1) / frame.chunkSize * frame.chunkSize);
+        }
+    }
+    if (!partial && offset != frame.size) return 0;
+
+    decoders.pool.run(count, [&](size_t i, size_t worker) {
+        DecodedSegment& segment = segments[i];
+        segment.decoded =
+            decoders.decoders[worker]->decode(segment.jpeg, segment.jpegSize, segment.image) &&
+            segment.image.cols == segment.rect.width && segment.image.rows == segment.rect.height;
+    });
+
+    // Битые сегменты пропускаются, остальные сдвигаются в начало без копирования картинок
+    size_t valid = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!segments[i].decoded) continue;
+        if (valid != i) std::swap(segments[valid], segments[i]);
+        valid++;
+    }
+    return valid;
+}
+
+void Receiver::publishFrame(cv::Mat& frame, uint64_t sequence, uint64_t captureTimestampUs,
+                            double decodeTimeMs) {
+    // Несколько декодеров завершают кадры в произвольном порядке: публикуем только
+    // кадры новее уже опубликованного, опоздавшие считаем устаревшими
     {
-        std::lock_guard<std::mutex> lock(framesMutex_);
-        auto& frame = frames_[fid];
-        frame.expected_chunks = total_chunks;
-        frame.timestamp = std::chrono::steady_clock::now();
-        std::vector<uint8_t> chunk(buffer.begin() + 12, buffer.begin() + recvLen);
-        data_received += chunk.size();
-        frame.chunks[chunk_no] = std::move(chunk);
-
-        if (frame.chunks.size() == total_chunks) {
-            std::vector<uint8_t> ordered_data;
-            for (uint16_t i = 0; i < total_chunks; ++i) {
-                if (frame.chunks.count(i)) {
-                    auto& chunk = frame.chunks[i];
-                    ordered_data.insert(ordered_data.end(), chunk.begin(), chunk.end());
-                }
-            }
-            std::cout << "Received " << data_received << " bytes in " << total_chunks << " chunks"
-                      << std::endl;
-            cv::Mat frame = cv::imdecode(ordered_data, cv::IMREAD_COLOR);
-            if (!frame.empty()) {
-                {
-                    std::lock_guard<std::mutex> frameLock(frameMutex_);
-                    lastFrame_ = frame.clone();
-                }
+        std::lock_guard<std::mutex> frameLock(frameMutex_);
+        if (hasFrame_ && sequence <= lastFrameSequence_) {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.totalStaleFrames++;
+            return;
+        }
+        // Кадр публикуется без копии, а декодер получает взамен буфер свободного кадра
+        // пула: на него больше никто не ссылается, и декодер перепишет его на месте
+        std::shared_ptr<VideoFrame> published = framePool_.acquire();
+        std::swap(published->image, frame);
+        published->sequence = sequence;
+        published->captureTimestampUs = captureTimestampUs;
+        published->publishTime = std::chrono::steady_clock::now();
+        latestFrame_.publish(std::move(published));
+        lastFrameSequence_ = sequence;
+        hasFrame_ = true;
+        canvasPublished_ = false;
+    }
+    notifyFrameWaiters();
+    updateDecodeStatistics(decodeTimeMs, 1.0);
+}
 
-                std::lock_guard<std::mutex> lock(statsMutex_);
-                stats_.totalFramesDecoded++;
-                auto now = std::chrono::steady_clock::now();
-                if (stats_.totalFramesDecoded > 1) {
-                    double delta =
-                        std::chrono::duration<double>(now - stats_.lastFrameTime).count();
-                    if (delta > 0) {
-                        double fps = 1.0 / delta;
-                        stats_.avgFps = (stats_.avgFps * (stats_.totalFramesDecoded - 1) + fps) /
-                                        stats_.totalFramesDecoded;
-                    }
-                }
-                stats_.lastFrameTime = now;
+void Receiver::publishSegments(const std::vector<DecodedSegment>& segments, size_t count,
+                               const cv::Size& frameSize, uint64_t sequence,
+                               uint64_t captureTimestampUs, double decodeTimeMs,
+                               double completeness) {
+    {
+        std::lock_guard<std::mutex> frameLock(frameMutex_);
+        // При смене разрешения холст создаётся заново; до первого полного кадра
+        // ещё не пришедшие сегменты остаются чёрными
+        if (canvas_.size() != frameSize) {
+            canvas_ = cv::Mat::zeros(frameSize, CV_8UC3);
+            segmentSequence_.clear();
+        }
+        // Последним опубликован цельный кадр - сегменты накладываются на него, чтобы
+        // не пришедшие полосы и тайлы скрывались предыдущим кадром, а не старым холстом
+        if (hasFrame_ && !canvasPublished_) {
+            FrameHandle latest = latestFrame_.load();
+            if (latest && latest->image.size() == frameSize && latest->image.type() == CV_8UC3) {
+                latest->image.copyTo(canvas_);
             }
-            data_received = 0;
-            frames_.erase(fid);
         }
+
+        // Кадры декодируются в произвольном порядке, поэтому старшинство проверяется
+        // для каждого сегмента отдельно: дельта старого кадра не затирает новый тайл
+        bool updated = false;
+        for (size_t i = 0; i < count; ++i) {
+            const DecodedSegment& segment = segments[i];
+            uint32_t key = static_cast<uint32_t>(segment.rect.x) << 16 | segment.rect.y;
+            uint64_t& segmentSequence = segmentSequence_[key];
+            if (segmentSequence >= sequence) continue;
+            segment.image.copyTo(canvas_(segment.rect));
+            segmentSequence = sequence;
+            updated = true;
+        }
+        if (!updated) {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.totalStaleFrames++;
+            return;
+        }
+
+        // Холст продолжают обновлять, поэтому публикуется его копия в буфер из пула
+        std::shared_ptr<VideoFrame> published = framePool_.acquire();
+        canvas_.copyTo(published->image);
+        lastFrameSequence_ = std::max(lastFrameSequence_, sequence);
+        published->sequence = lastFrameSequence_;
+        published->captureTimestampUs = captureTimestampUs;
+        published->publishTime = std::chrono::steady_clock::now();
+        latestFrame_.publish(std::move(published));
+        hasFrame_ = true;
+        canvasPublished_ = true;
+    }
+    notifyFrameWaiters();
+    updateDecodeStatistics(decodeTimeMs, completeness);
+}
+
+void Receiver::publishEncoded(std::shared_ptr<EncodedVideoFrame> frame) {
+    {
+        std::lock_guard<std::mutex> frameLock(frameMutex_);
+        if (frame->sequence <= lastEncodedSequence_) return;
+        lastEncodedSequence_ = frame->sequence;
+        frame->publishTime = std::chrono::steady_clock::now();
+        latestEncodedFrame_.publish(std::move(frame));
     }
+    notifyFrameWaiters();
+}
+
+void Receiver::updatePassthroughStatistics() {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.totalFramesPassedThrough++;
+    updateFrameRate(std::chrono::steady_clock::now());
+}
+
+void Receiver::updateDecodeStatistics(double decodeTimeMs, double completeness) {
+    decodeLatency_.record(static_cast<uint64_t>(decodeTimeMs * 1000.0));
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.totalFramesDecoded++;
+    if (completeness < 1.0) stats_.totalPartialFrames++;
+    stats_.lastFrameCompleteness = completeness;
+    stats_.avgFrameCompleteness = (stats_.avgFrameCompleteness * (stats_.totalFramesDecoded - 1) +
+                                   completeness) /
+                                  stats_.totalFramesDecoded;
+    stats_.lastDecodeTimeMs = decodeTimeMs;
+    stats_.avgDecodeTimeMs = (stats_.avgDecodeTimeMs * (stats_.totalFramesDecoded - 1) +
+                              decodeTimeMs) /
+                             stats_.totalFramesDecoded;
+    updateFrameRate(std::chrono::steady_clock::now());
+}
+
+// FPS и джиттер по всем опубликованным кадрам; вызывается под statsMutex_
+void Receiver::updateFrameRate(std::chrono::steady_clock::time_point now) {
+    framesDelivered_++;
+    if (framesDelivered_ > 1) {
+        double delta = std::chrono::duration<double>(now - stats_.lastFrameTime).count();
+        if (delta > 0) {
+            double fps = 1.0 / delta;
+            stats_.avgFps = (stats_.avgFps * (framesDelivered_ - 1) + fps) / framesDelivered_;
+        }
+
+        // Джиттер как у RTP (RFC 3550): J += (|D| - J) / 16, D - изменение интервала
+        double intervalMs = delta * 1000.0;
+        if (framesDelivered_ > 2) {
+            stats_.jitterMs += (std::abs(intervalMs - lastFrameIntervalMs_) - stats_.jitterMs) / 16;
+        }
+        lastFrameIntervalMs_ = intervalMs;
+    }
+    stats_.lastFrameTime = now;
+
+    // FPS по кадрам последнего окна, а не за всё время
+    const auto window = std::chrono::duration<double>(FPS_WINDOW_S);
+    frameTimes_.push_back(now);
+    while (now - frameTimes_.front() > window) frameTimes_.pop_front();
+    double span = std::chrono::duration<double>(now - frameTimes_.front()).count();
+    stats_.windowFps = span > 0 ? (frameTimes_.size() - 1) / span : 0.0;
 }
 
 void Receiver::cleanupExpiredFrames() {
-    auto now = std::chrono::steady_clock::now();
-    std::vector<std::string> to_remove;
+    auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(5);
+    assembler_.dropExpired(deadline, [](uint32_t frameSeq, uint16_t lost) {
+        MULTICAST_LOG_DEBUG("Dropping frame %u (lost %u chunks)", frameSeq,
+                            static_cast<unsigned>(lost));
+    });
+}
+
+cv::Mat Receiver::getLatestFrame() {
+    FrameHandle frame = getLatestFrameHandle();
+    return frame ? frame->image.clone() : cv::Mat();
+}
 
+FrameHandle Receiver::getLatestFrameHandle() {
+    FrameHandle frame = latestFrame_.load();
+    if (frame) recordPickup(frame->sequence, frame->publishTime);
+    return frame;
+}
+
+EncodedFrameHandle Receiver::getLatestEncodedFrame() {
+    EncodedFrameHandle frame = latestEncodedFrame_.load();
+    if (frame) recordPickup(frame->sequence, frame->publishTime);
+    return frame;
+}
+
+template <typename Frame>
+std::shared_ptr<const Frame> Receiver::waitForPublished(const LatestFrame<Frame>& latest,
+                                                        uint64_t lastSequence,
+                                                        std::chrono::milliseconds timeout) {
+    std::shared_ptr<const Frame> frame;
     {
-        std::lock_guard<std::mutex> lock(framesMutex_);
-        for (auto& [fid, frame] : frames_) {
-            auto elapsed =
-                std::chrono::duration_cast<std::chrono::seconds>(now - frame.timestamp).count();
-
-            if (elapsed > 5) {
-                uint16_t lost = frame.expected_chunks - frame.chunks.size();
-                std::cout << "Dropping frame " << std::hex << std::setfill('0');
-                for (uint8_t c : fid) std::cout << std::setw(2) << static_cast<int>(c);
-                std::cout << " (lost " << std::dec << lost << " chunks)\n";
-                to_remove.push_back(fid);
-            }
+        std::unique_lock<std::mutex> lock(frameWaitMutex_);
+        frameCv_.wait_for(lock, timeout, [&] {
+            frame = latest.load();
+            return (frame && frame->sequence > lastSequence) || !isReceiving_;
+        });
+    }
+    if (!frame || frame->sequence <= lastSequence) return nullptr;
+    recordPickup(frame->sequence, frame->publishTime);
+    return frame;
+}
+
+FrameHandle Receiver::waitForFrame(uint64_t lastSequence, std::chrono::milliseconds timeout) {
+    return waitForPublished(latestFrame_, lastSequence, timeout);
+}
+
+EncodedFrameHandle Receiver::waitForEncodedFrame(uint64_t lastSequence,
+                                                 std::chrono::milliseconds timeout) {
+    return waitForPublished(latestEncodedFrame_, lastSequence, timeout);
+}
+
+void Receiver::setDecodeEnabled(bool enabled) {
+    decodeEnabled_.store(enabled, std::memory_order_relaxed);
+}
+
+size_t Receiver::addFrameCallback(FrameCallback callback) {
+    auto shared = std::make_shared<FrameCallback>(std::move(callback));
+    std::lock_guard<std::mutex> lock(callbacksMutex_);
+    size_t id = nextCallbackId_++;
+    frameCallbacks_.emplace(id, std::move(shared));
+    return id;
+}
+
+void Receiver::removeFrameCallback(size_t id) {
+    // Ждём конца текущего прохода, если он идёт в другом потоке: из самого обработчика
+    // ждать нельзя - он и есть этот проход. Обработчик уничтожается уже без мьютекса
+    std::shared_ptr<FrameCallback> removed;
+    {
+        std::unique_lock<std::mutex> lock(callbacksMutex_);
+        auto it = frameCallbacks_.find(id);
+        if (it == frameCallbacks_.end()) return;
+        removed = std::move(it->second);
+        frameCallbacks_.erase(it);
+        if (std::this_thread::get_id() != callbackThread_.get_id()) {
+            callbacksCv_.wait(lock, [this] { return !callbacksRunning_; });
         }
     }
+}
 
-    std::lock_guard<std::mutex> lock(framesMutex_);
-    for (auto& fid : to_remove) {
-        frames_.erase(fid);
+void Receiver::callbackLoop() {
+    uint64_t lastSequence = 0;
+    std::vector<std::pair<size_t, std::shared_ptr<FrameCallback>>> snapshot;
+    while (isReceiving_) {
+        FrameHandle frame =
+            waitForFrame(lastSequence, std::chrono::milliseconds(CALLBACK_POLL_INTERVAL_MS));
+        if (!frame) continue;
+        lastSequence = frame->sequence;
+
+        {
+            std::lock_guard<std::mutex> lock(callbacksMutex_);
+            snapshot.assign(frameCallbacks_.begin(), frameCallbacks_.end());
+            callbacksRunning_ = true;
+        }
+        for (auto& [id, callback] : snapshot) {
+            // Обработчик мог удалить другой обработчик из этого же снимка
+            {
+                std::lock_guard<std::mutex> lock(callbacksMutex_);
+                if (frameCallbacks_.find(id) == frameCallbacks_.end()) continue;
+            }
+            try {
+                (*callback)(frame);
+            } catch (const std::exception& e) {
+                MULTICAST_LOG_ERROR("Frame callback %zu failed: %s", id, e.what());
+            }
+        }
+        snapshot.clear();
+        {
+            std::lock_guard<std::mutex> lock(callbacksMutex_);
+            callbacksRunning_ = false;
+        }
+        callbacksCv_.notify_all();
     }
 }
 
-cv::Mat Receiver::getLatestFrame() {
-    std::lock_guard<std::mutex> lock(frameMutex_);
-    return lastFrame_.clone();
+void Receiver::notifyFrameWaiters() {
+    // Пустая критическая секция: ожидающий либо ещё не проверил условие и увидит новый
+    // кадр, либо уже спит и получит notify
+    { std::lock_guard<std::mutex> lock(frameWaitMutex_); }
+    frameCv_.notify_all();
+}
+
+void Receiver::recordPickup(uint64_t sequence,
+                            std::chrono::steady_clock::time_point publishTime) {
+    // pickupLatency учитывает только первое чтение каждого кадра, даже если читателей много
+    // и кадр забирают и декодированным, и как JPEG
+    uint64_t pickedUp = pickedUpSequence_.load(std::memory_order_relaxed);
+    while (pickedUp < sequence) {
+        if (pickedUpSequence_.compare_exchange_weak(pickedUp, sequence,
+                                                    std::memory_order_relaxed)) {
+            pickupLatency_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - publishTime)
+                                      .count());
+            break;
+        }
+    }
 }
 
 bool Receiver::isReceiving() {
@@ -226,28 +667,95 @@ bool Receiver::isReceiving() {
 }
 
 ReceiverStatistics Receiver::getStatistics() {
-    std::lock_guard<std::mutex> lock(statsMutex_);
-    return stats_;
+    ReceiverStatistics stats;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats = stats_;
+    }
+    stats.decodeQueueDepth = decodeQueue_.size();
+    stats.totalReceiveSyscalls = transport_->syscallCount();
+    stats.totalPacketsReceived = packetsReceived_.load(std::memory_order_relaxed);
+    stats.totalCorruptedPackets = corruptedPackets_.load(std::memory_order_relaxed);
+    stats.totalRecoveredChunks = recoveredChunks_.load(std::memory_order_relaxed);
+    stats.captureToEncodeLatency = captureToEncodeLatency_.summary();
+    stats.captureToSendLatency = captureToSendLatency_.summary();
+    stats.reassemblyLatency = reassemblyLatency_.summary();
+    stats.decodeLatency = decodeLatency_.summary();
+    stats.pickupLatency = pickupLatency_.summary();
+    return stats;
 }
 
-bool Receiver::sendHeartbeat(const sockaddr_in& senderAddr) {
-    int controlSock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (controlSock < 0) {
-        perror("heartbeat socket failed");
-        return false;
-    }
+bool Receiver::sendHeartbeat() {
+    // HEARTBEAT:<id>:<доля потерянных кадров>:<FPS> - обратная связь для адаптации битрейта
+    updateFeedbackWindow();
+    char heartbeat[64];
+    int len = snprintf(heartbeat, sizeof(heartbeat), HEARTBEAT_PREFIX "%s:%.4f:%.2f",
+                       receiverID_.c_str(), feedbackLossRatio_, feedbackFps_);
+    return transport_->sendControl(heartbeat, len);
+}
+
+void Receiver::updateFeedbackWindow() {
+    // Потери и FPS считаются по окну, а не за всё время, чтобы Sender видел текущее состояние
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - feedbackWindowStart_).count();
+    if (elapsed < FEEDBACK_WINDOW_S) return;
 
-    std::string heartbeat = "HEARTBEAT:" + receiverID_;
+    uint64_t dropped = assembler_.droppedFrames();
+    uint64_t completed = framesCompleted_ - feedbackCompleted_;
+    // Кадр, показанный без части полос, для регулятора битрейта тоже потерян
+    uint64_t lost = dropped - feedbackDropped_ + framesPartial_ - feedbackPartial_;
+    feedbackLossRatio_ = completed + lost ? double(lost) / double(completed + lost) : 0.0;
+    feedbackFps_ = completed / elapsed;
 
-    sockaddr_in controlAddr = senderAddr;
-    controlAddr.sin_port = htons(5050);  // управляющий порт Sender’а
+    feedbackWindowStart_ = now;
+    feedbackCompleted_ = framesCompleted_;
+    feedbackDropped_ = dropped;
+    feedbackPartial_ = framesPartial_;
 
-    ssize_t sent = sendto(controlSock, heartbeat.c_str(), heartbeat.size(), 0,
-                          (sockaddr*)&controlAddr, sizeof(controlAddr));
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.totalFramesDropped = dropped;
+}
 
-    close(controlSock);
+void Receiver::collectPartialFrames() {
+    CompletedFrame frames[MAX_PARTIAL_PER_POLL];
+    size_t count = assembler_.collectPartial(std::chrono::steady_clock::now(),
+                                             std::chrono::milliseconds(config_.partialFrameDelayMs),
+                                             frames, MAX_PARTIAL_PER_POLL);
+    for (size_t i = 0; i < count; ++i) {
+        framesPartial_++;
+        MULTICAST_LOG_DEBUG("Partial frame %u: %u/%u chunks", frames[i].frameSeq,
+                            static_cast<unsigned>(frames[i].receivedChunks),
+                            static_cast<unsigned>(frames[i].totalChunks));
+        enqueueForDecode(frames[i]);
+    }
+}
 
-    return sent >= 0;
+void Receiver::sendNacks() {
+    if (!hasSenderAddr_) return;
+
+    NackRequest requests[MAX_NACKS_PER_POLL];
+    size_t count = assembler_.collectNacks(
+        std::chrono::steady_clock::now(), std::chrono::milliseconds(config_.nackDelayMs),
+        std::chrono::milliseconds(config_.nackRetryMs), config_.maxNackRetries, requests,
+        MAX_NACKS_PER_POLL);
+    if (count == 0) return;
+
+    // Формат см. NACK_PREFIX в protocol.h; сообщение собирается в стековом буфере
+    char message[1024];
+    for (size_t r = 0; r < count; ++r) {
+        const NackRequest& request = requests[r];
+        int len = snprintf(message, sizeof(message), NACK_PREFIX "%s:%u:", receiverID_.c_str(),
+                           request.frameSeq);
+        for (size_t i = 0; i < request.rangeCount && len < 1000; ++i) {
+            len += snprintf(message + len, sizeof(message) - len, "%s%u-%u", i ? "," : "",
+                            request.ranges[i][0], request.ranges[i][1]);
+        }
+
+        if (transport_->sendControl(message, len)) {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.totalNacksSent++;
+        }
+    }
 }
 
 std::string Receiver::generateClientID() {
@@ -1,66 +1,129 @@
 #include "sender.h"
 
 #include <arpa/inet.h>
-#include <unistd.h>
+#include <endian.h>
+#include <sys/uio.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <opencv2/opencv.hpp>
 #include <random>
 
+#include "fec.h"
+#include "logging.h"
+
+// Максимальное число датаграмм в одном вызове sendmmsg
+#define SEND_BATCH_SIZE 64
+// Верхняя граница чанков данных в группе FEC
+#define MAX_FEC_GROUP_SIZE 64
+#define NACK_PREFIX_LEN (sizeof(NACK_PREFIX) - 1)
+#define HEARTBEAT_PREFIX_LEN (sizeof(HEARTBEAT_PREFIX) - 1)
+// Клиент без heartbeat'ов дольше таймаута считается отключившимся; колесо таймеров
+// реестра клиентов поворачивается с шагом тика, с ним же просыпается управляющий поток
+#define CLIENT_TIMEOUT_MS 3000
+#define CLIENT_WHEEL_TICK_MS 100
+// Управляющие датаграммы забираются пачками recvmmsg
+#define CONTROL_BATCH_SIZE 64
+#define CONTROL_MESSAGE_SIZE 1024
+
 namespace MulticastLib {
 
-Sender::Sender(const std::string& multicastIP, int port)
-    : multicastIP_(multicastIP), port_(port), isStreaming_(false), sockfd_(-1) {}
+namespace {
 
-Sender::~Sender() {
-    if (sockfd_ != -1) close(sockfd_);
-    if (streamThread_.joinable()) streamThread_.join();
-    if (camera_.isOpened()) camera_.release();
-    stopStream();
+// Микросекунды от момента since по steady_clock, с насыщением до uint32_t
+uint32_t elapsedUs(std::chrono::steady_clock::time_point since) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - since);
+    return static_cast<uint32_t>(std::clamp<int64_t>(elapsed.count(), 0, UINT32_MAX));
 }
 
-bool Sender::setupSocket() {
-    // Создание и конфигурация сокета
-    sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd_ < 0) {
-        std::cerr << "Failed to create socket" << std::endl;
-        return false;
+// Инкремент счётчика, который пишет только текущий поток
+void bump(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+Sender::Sender(const std::string& multicastIP, int port)
+    : Sender(multicastIP, port, SenderConfig()) {}
+
+Sender::Sender(const std::string& multicastIP, int port, const SenderConfig& config)
+    : multicastIP_(multicastIP),
+      port_(port),
+      config_(config),
+      transport_(makeUdpSenderTransport(multicastIP, port, config.ioBackend,
+                                        config.segmentationOffload)),
+      isStreaming_(false),
+      captureQueue_(std::max(1, config.queueCapacity)),
+      encodeQueue_(std::max(1, config.queueCapacity)),
+      clients_(std::chrono::milliseconds(CLIENT_TIMEOUT_MS),
+               std::chrono::milliseconds(CLIENT_WHEEL_TICK_MS)),
+      rateController_(config.targetBitrateKbps, config.maxLossRatio,
+                      std::min(std::max(1, config.jpegQuality), 100),
+                      config.targetFps > 0 ? config.targetFps : 30.0),
+      jpegQuality_(rateController_.current().jpegQuality),
+      currentFps_(rateController_.current().fps) {
+    if (config_.targetFps <= 0) config_.targetFps = 30.0;
+    config_.fecGroupSize = std::min(std::max(0, config_.fecGroupSize), MAX_FEC_GROUP_SIZE);
+    config_.mtu = std::clamp<int>(config_.mtu, MIN_MTU, MAX_MTU);
+    chunkSize_ = chunkSizeForMtu(config_.mtu);
+    if (config_.tileSize > 0) {
+        tileEncoder_ = std::make_unique<TileDeltaEncoder>(
+            config_.tileSize, config_.tileChangeThreshold, config_.tileRefreshInterval);
+    } else if (config_.stripCount > 1) {
+        int threads = config_.stripThreads > 0
+                          ? config_.stripThreads
+                          : static_cast<int>(std::thread::hardware_concurrency());
+        stripEncoder_ = std::make_unique<StripEncoder>(config_.stripCount,
+                                                       std::min(threads, config_.stripCount));
     }
+    retransmitRing_.resize(std::max(1, config_.retransmitFrames));
+    source_ = makeFrameSource(config_.source);
 
-    // time to live для мультикаст пакетов = 1 позволяет доставлять пакеты только локально
-    int ttl = 1;
-    if (setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
-        perror("setsockopt IP_MULTICAST_TTL failed");
-        return false;
+    // Кадры одновременно живут в двух очередях, в стадии отправки и в кольце перепосылки
+    size_t poolSize = 2 * captureQueue_.capacity() + retransmitRing_.size() + 2;
+    for (size_t i = 0; i < poolSize; ++i) {
+        encodeBuffers_.push_back(std::make_shared<std::vector<uchar>>());
     }
 
-    memset(&multicastAddr_, 0, sizeof(multicastAddr_));
-    multicastAddr_.sin_family = AF_INET;
-    multicastAddr_.sin_addr.s_addr = inet_addr(multicastIP_.c_str());
-    multicastAddr_.sin_port = htons(port_);
-    return true;
+    // Один вызов random_device на Sender, дальше номера кадров идут подряд
+    std::random_device rd;
+    nextFrameSeq_ = rd();
 }
 
+Sender::~Sender() { stopStream(); }
+
 bool Sender::startStream() {
     // Начинает стрим
     if (isStreaming_) return false;
-    if (!setupSocket()) return false;
+    // Управляющий поток просыпается не реже тика колеса, чтобы вовремя удалять
+    // замолчавших клиентов
+    if (!transport_->open(std::chrono::milliseconds(CLIENT_WHEEL_TICK_MS))) return false;
 
-    // Включение камеры
-    camera_.open(0, cv::CAP_ANY);
-    if (!camera_.isOpened()) {
-        std::cerr << "Failed to open camera_" << std::endl;
+    if (!source_->open()) {
+        MULTICAST_LOG_ERROR("Failed to open frame source %s", source_->name().c_str());
+        transport_->close();
         return false;
     }
 
     isStreaming_ = true;
+    // Новая сессия начинается с полного кадра
+    if (tileEncoder_) tileEncoder_->forceRefresh();
 
-    // Запуск потока для захвата и отправки видео
-    streamThread_ = std::thread(&Sender::streamLoop, this);
+    // Запуск стадий конвейера
+    transmitThread_ = std::thread(&Sender::transmitLoop, this);
+    encodeThread_ = std::thread(&Sender::encodeLoop, this);
+    captureThread_ = std::thread(&Sender::captureLoop, this);
     startControlListener();
-    cleanupThread_ = std::thread([this]() {
+    rateWindowStart_ = std::chrono::steady_clock::now();
+    rateWindowBytes_ = transmitCounters_.bytes.load(std::memory_order_relaxed) +
+                       retransmitCounters_.bytes.load(std::memory_order_relaxed);
+    rateWindowFrames_ = transmitCounters_.frames.load(std::memory_order_relaxed);
+    rateControlThread_ = std::thread([this]() {
         while (isStreaming_) {
-            cleanupInactiveClients();
+            updateRateControl();
             std::this_thread::sleep_for(std::chrono::seconds(1));  // повторять каждую секунду
         }
     });
@@ -70,176 +133,572 @@ bool Sender::startStream() {
 void Sender::stopStream() {
     // Останавливает стрим и освобождает ресурсы
     isStreaming_ = false;
-    if (streamThread_.joinable()) streamThread_.join();
-    camera_.release();
+    if (captureThread_.joinable()) captureThread_.join();
+    if (encodeThread_.joinable()) encodeThread_.join();
+    if (transmitThread_.joinable()) transmitThread_.join();
+    source_->close();
     if (controlThread_.joinable()) controlThread_.join();
-    if (cleanupThread_.joinable()) cleanupThread_.join();
-    activeClientCount_ = 0;
-    close(sockfd_);
+    if (rateControlThread_.joinable()) rateControlThread_.join();
+    // Управляющий поток остановлен, реестр больше никто не меняет
+    clients_.clear();
+
+    // Выбрасываем то, что осталось в очередях
+    CapturedFrame staleFrame;
+    while (captureQueue_.tryPop(staleFrame)) {
+    }
+    EncodedFrame staleEncoded;
+    while (encodeQueue_.tryPop(staleEncoded)) {
+    }
+
+    transport_->close();
+}
+
+bool Sender::setTransport(std::unique_ptr<SenderTransport> transport) {
+    if (isStreaming_ || !transport) return false;
+    transport_ = std::move(transport);
+    return true;
+}
+
+bool Sender::setFrameSource(std::unique_ptr<FrameSource> source) {
+    if (isStreaming_ || !source) return false;
+    source_ = std::move(source);
+    return true;
+}
+
+template <typename T>
+bool Sender::pushToStage(FrameQueue<T>& queue, T&& item) {
+    if (config_.dropOldest) {
+        size_t dropped = queue.pushDropOldest(std::move(item));
+        framesDropped_.fetch_add(dropped, std::memory_order_relaxed);
+        return dropped == 0;
+    }
+    // Блокирующая политика: ждём потребителя, пока стрим активен
+    while (isStreaming_) {
+        if (queue.pushWait(std::move(item), std::chrono::milliseconds(100))) return true;
+    }
+    return false;
 }
 
-void Sender::streamLoop() {
+void Sender::captureLoop() {
+    using Clock = std::chrono::steady_clock;
+    FramePacer pacer;
+    pacer.start();
+    uint64_t captureSequence = 0;
+
     while (isStreaming_) {
-        // Захват кадра
-        cv::Mat frame;
-        camera_ >> frame;
-        if (frame.empty()) {
-            std::cerr << "Failed to capture frame" << std::endl;
+        // Частоту может понизить регулятор битрейта
+        const auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / currentFps_.load(std::memory_order_relaxed)));
+
+        // Захват кадра; Mat каждый раз новый, поэтому превью и очередь делят один буфер
+        CapturedFrame frame;
+        auto readStart = Clock::now();
+        if (!source_->read(frame.image)) {
+            if (source_->exhausted()) {
+                MULTICAST_LOG_INFO("Frame source %s is exhausted", source_->name().c_str());
+                break;
+            }
+            bump(captureCounters_.failures);
+            MULTICAST_LOG_WARNING("Failed to capture frame");
+            // Отключённая камера или битый файл отказывают сразу: повтор - в темпе захвата,
+            // а не в цикле на целое ядро. Отставание здесь не считается
+            pacer.waitNext(interval);
             continue;
         }
+        frame.captureTime = Clock::now();
+        captureLatency_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   frame.captureTime - readStart)
+                                   .count());
+        frame.captureTimestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                       std::chrono::system_clock::now().time_since_epoch())
+                                       .count();
+        bump(captureCounters_.frames);
+        traceSpan("capture", "sender", readStart, frame.captureTime, frame.captureTimestampUs);
+
+        // Превью делит буфер с кадром в очереди: после захвата его никто не меняет
+        auto preview = std::make_shared<VideoFrame>();
+        preview->image = frame.image;
+        preview->sequence = ++captureSequence;
+        preview->captureTimestampUs = frame.captureTimestampUs;
+        preview->publishTime = frame.captureTime;
+        previewFrame_.publish(std::move(preview));
+
+        pushToStage(captureQueue_, std::move(frame));
+
+        // Темп задаётся абсолютными дедлайнами, время захвата не накапливается в задержке.
+        // Если отстали больше чем на кадр - начинаем отсчёт заново, а не догоняем пачкой
+        if (!pacer.waitNext(interval)) bump(captureCounters_.stalls);
+    }
+}
 
-        // Запоминание последнего кадра (для вывода превью)
-        {
-            std::lock_guard<std::mutex> lock(lastFrameMutex_);
-            this->lastFrame_ = frame.clone();
+std::shared_ptr<std::vector<uchar>> Sender::acquireEncodeBuffer() {
+    // Буфер свободен, если на него ссылается только пул. Новую ссылку никто, кроме
+    // этого потока, взять не может; fence синхронизирует с освободившим буфер потоком
+    for (auto& buffer : encodeBuffers_) {
+        if (buffer.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return buffer;
         }
-
-        // Отправка кадра по multicast
-        sendFrameToMulticast(frame.clone());
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(33));  // Задержка, выходит примерно 30 FPS
     }
+    return std::make_shared<std::vector<uchar>>();
 }
 
-void Sender::sendFrameToMulticast(const cv::Mat& frame) {
-    // Downgrade фрейма, чтобы влез в один UDP пакет
-    const size_t CHUNK_SIZE = 1024;  // Размер чанка в байтах
+void Sender::encodeLoop() {
+    cv::Mat scaled;
+    while (isStreaming_) {
+        CapturedFrame frame;
+        if (!captureQueue_.popWait(frame, std::chrono::milliseconds(100))) continue;
+
+        // Рабочая точка регулятора битрейта: качество и масштаб
+        int quality = jpegQuality_.load(std::memory_order_relaxed);
+        double scale = frameScale_.load(std::memory_order_relaxed);
+        if (scale < 1.0) {
+            cv::resize(frame.image, scaled, cv::Size(), scale, scale, cv::INTER_AREA);
+            frame.image = scaled;
+        }
 
-    struct {
-        uint8_t frame_id[8];
-        uint16_t chunk_num;
-        uint16_t total_chunks;
-    } header;
+        // Сжимаем кадр в JPEG
+        EncodedFrame encoded;
+        encoded.captureTime = frame.captureTime;
+        encoded.captureTimestampUs = frame.captureTimestampUs;
+        encoded.data = acquireEncodeBuffer();
+        auto encodeStart = std::chrono::steady_clock::now();
+        bool ok = true;
+        if (tileEncoder_) {
+            // Ничего не изменилось - кадр не отправляется
+            if (!tileEncoder_->encode(frame.image, quality, *encoded.data, &encoded.flags)) {
+                continue;
+            }
+        } else if (stripEncoder_) {
+            size_t alignment = config_.alignStripsToChunks ? chunkSize_ : 0;
+            ok = stripEncoder_->encode(frame.image, quality, *encoded.data, &encoded.flags,
+                                       alignment);
+        } else {
+            ok = jpegEncoder_.encode(frame.image, quality, *encoded.data);
+        }
+        if (!ok) {
+            bump(encodeCounters_.failures);
+            continue;
+        }
+        encodeLatency_.record(elapsedUs(encodeStart));
+        traceSpan("encode", "sender", encodeStart, std::chrono::steady_clock::now(),
+                  frame.captureTimestampUs);
+        bump(encodeCounters_.frames);
+        bump(encodeCounters_.bytes, encoded.data->size());
+        encodeCounters_.lastFrameSize.store(encoded.data->size(), std::memory_order_relaxed);
+        encoded.encodeDelayUs = elapsedUs(frame.captureTime);
+        // Выброшенный дельта-кадр уносит изменения тайлов - следующий кадр будет полным
+        if (!pushToStage(encodeQueue_, std::move(encoded)) && tileEncoder_) {
+            tileEncoder_->forceRefresh();
+        }
+    }
+}
 
-    // Сжимаем кадр в JPEG
-    std::vector<uchar> buffer;
-    std::vector<int> params{cv::IMWRITE_JPEG_QUALITY, 80};
-    cv::imencode(".jpg", frame, buffer, params);
+void Sender::transmitLoop() {
+    while (isStreaming_) {
+        EncodedFrame encoded;
+        if (!encodeQueue_.popWait(encoded, std::chrono::milliseconds(100))) continue;
+
+        // Рассчитываем количество чанков
+        const size_t total_chunks = (encoded.data->size() + chunkSize_ - 1) / chunkSize_;
+        if (total_chunks == 0 || total_chunks > MAX_DATA_CHUNKS) {
+            MULTICAST_LOG_WARNING("Frame of %zu bytes cannot be chunked", encoded.data->size());
+            if (tileEncoder_) tileEncoder_->forceRefresh();
+            continue;
+        }
 
-    // Генерируем 8-байтовый UUID
-    std::array<uint8_t, 8> frame_id;
-    std::random_device rd;
-    std::generate(frame_id.begin(), frame_id.end(), [&]() { return rd() % 256; });
+        FrameMeta frame;
+        frame.frameSeq = nextFrameSeq_++;
+        frame.captureTimestampUs = encoded.captureTimestampUs;
+        frame.frameSize = static_cast<uint32_t>(encoded.data->size());
+        frame.totalChunks = static_cast<uint16_t>(total_chunks);
+        frame.chunkSize = static_cast<uint16_t>(chunkSize_);
+        frame.fecGroup = static_cast<uint8_t>(config_.fecGroupSize);
+        frame.flags = encoded.flags;
+        frame.encodeDelayUs = encoded.encodeDelayUs;
+        frame.sendDelayUs = elapsedUs(encoded.captureTime);
+        captureToSendLatency_.record(frame.sendDelayUs);
+
+        // Отправка кадра по multicast; кадр остаётся в кольце для перепосылки по NACK
+        auto sendStart = std::chrono::steady_clock::now();
+        sendFrameToMulticast(*encoded.data, frame);
+        transmitLatency_.record(elapsedUs(sendStart));
+        traceSpan("send", "sender", sendStart, std::chrono::steady_clock::now(),
+                  frame.captureTimestampUs);
+        rememberFrame(frame, std::move(encoded.data));
+    }
+}
 
-    // Рассчитываем количество чанков
-    const size_t total_chunks = (buffer.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+void Sender::resetBatch(TxBatch& batch, size_t capacity) {
+    // Заголовки и iovec'и не должны переезжать, пока на них ссылаются сообщения
+    batch.headers.resize(capacity);
+    batch.iovecs.resize(capacity * 2);
+    batch.messages.resize(capacity);
+    batch.count = 0;
+}
 
-    // Отправляем чанки
-    ssize_t sent = 0;
-    for (size_t i = 0; i < total_chunks; ++i) {
-        // Формируем заголовок
-        memcpy(header.frame_id, frame_id.data(), 8);
-        header.chunk_num = htons(static_cast<uint16_t>(i));
-        header.total_chunks = htons(static_cast<uint16_t>(total_chunks));
+void Sender::addChunkMessage(TxBatch& batch, const FrameMeta& frame, uint8_t flags,
+                             uint16_t chunkIndex, const void* payload, size_t len) {
+    size_t m = batch.count++;
+    ChunkHeader& header = batch.headers[m];
+    header.version = PROTOCOL_VERSION;
+    header.header_len = sizeof(ChunkHeader);
+    header.flags = frame.flags | flags;
+    header.fec_group = frame.fecGroup;
+    header.frame_seq = htonl(frame.frameSeq);
+    header.capture_ts_us = htobe64(frame.captureTimestampUs);
+    header.frame_size = htonl(frame.frameSize);
+    header.payload_offset = htonl(static_cast<uint32_t>(chunkIndex) * frame.chunkSize);
+    header.payload_len = htons(static_cast<uint16_t>(len));
+    header.chunk_index = htons(chunkIndex);
+    header.total_chunks = htons(frame.totalChunks);
+    header.chunk_size = htons(frame.chunkSize);
+    header.encode_delay_us = htonl(frame.encodeDelayUs);
+    header.send_delay_us = htonl(frame.sendDelayUs);
+
+    // Заголовок и кусок JPEG-буфера уходят в ядро без копирования в отдельный пакет
+    batch.iovecs[2 * m] = {&header, sizeof(header)};
+    batch.iovecs[2 * m + 1] = {const_cast<void*>(payload), len};
+
+    msghdr& msg = batch.messages[m].msg_hdr;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &batch.iovecs[2 * m];
+    msg.msg_iovlen = 2;
+}
 
-        // Формируем пакет
-        std::vector<uchar> packet(sizeof(header) + CHUNK_SIZE);
-        memcpy(packet.data(), &header, sizeof(header));
+uint64_t Sender::flushBatch(TxBatch& batch, SendCounters& counters) {
+    // Отправляем пачками по SEND_BATCH_SIZE сообщений за системный вызов
+    size_t next = 0;
+    uint64_t sent = 0;
+    while (next < batch.count) {
+        unsigned int count = std::min<size_t>(SEND_BATCH_SIZE, batch.count - next);
+        int n = transport_->sendBatch(&batch.messages[next], count);
+        bump(counters.syscalls);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                bump(counters.wouldBlock);
+            } else {
+                bump(counters.errors);
+            }
+            MULTICAST_LOG_ERROR("sendmmsg failed: %s", strerror(errno));
+            break;
+        }
+        for (int k = 0; k < n; ++k) sent += batch.messages[next + k].msg_len;
+        next += n;
+    }
 
-        // Копируем данные чанка
-        size_t offset = i * CHUNK_SIZE;
-        size_t chunk_size = std::min(CHUNK_SIZE, buffer.size() - offset);
-        memcpy(packet.data() + sizeof(header), buffer.data() + offset, chunk_size);
+    bump(counters.packets, next);
+    bump(counters.bytes, sent);
+    batch.count = 0;
+    return sent;
+}
 
-        // Отправка
-        sent += sendto(sockfd_, packet.data(), packet.size(), 0, (struct sockaddr*)&multicastAddr_,
-                       sizeof(multicastAddr_));
-    }
+void Sender::sendFrameToMulticast(const std::vector<uchar>& buffer, const FrameMeta& frame) {
+    const size_t total_chunks = frame.totalChunks;
+    const size_t chunk_size = frame.chunkSize;
+
+    // FEC: на каждые fecGroup чанков данных - один пакет чётности сразу после группы.
+    // Длина последнего чанка приёмник выводит из frame_size, отдельный заголовок не нужен
+    const size_t group_size = frame.fecGroup;
+    const size_t total_groups = group_size ? (total_chunks + group_size - 1) / group_size : 0;
+
+    resetBatch(txBatch_, total_chunks + total_groups);
+    txParity_.resize(total_groups * chunk_size);
+
+    const uint8_t* chunks[MAX_FEC_GROUP_SIZE];
+    size_t lengths[MAX_FEC_GROUP_SIZE];
+    const size_t step = group_size ? group_size : total_chunks;
+    for (size_t first = 0, group = 0; first < total_chunks; first += step, ++group) {
+        size_t last = std::min(first + step, total_chunks);
+        for (size_t i = first; i < last; ++i) {
+            size_t offset = i * chunk_size;
+            size_t len = std::min(chunk_size, buffer.size() - offset);
+            addChunkMessage(txBatch_, frame, 0, static_cast<uint16_t>(i), buffer.data() + offset,
+                            len);
+            if (group_size) {
+                chunks[i - first] = buffer.data() + offset;
+                lengths[i - first] = len;
+            }
+        }
+        if (!group_size) continue;
 
-    if (sent < 0) {
-        perror("sendto failed");
-    } else {
-        std::cout << "Sent " << sent << " bytes in " << total_chunks << " chunks" << std::endl;
+        uint8_t* parity = txParity_.data() + group * chunk_size;
+        computeParity(parity, chunks, lengths, last - first, chunk_size);
+        addChunkMessage(txBatch_, frame, CHUNK_FLAG_PARITY, static_cast<uint16_t>(group), parity,
+                        chunk_size);
     }
+
+    flushBatch(txBatch_, transmitCounters_);
+    bump(transmitCounters_.frames);
+    bump(transmitCounters_.dataPackets, total_chunks);
 }
 
-cv::Mat Sender::getPreviewFrame() {
-    std::lock_guard<std::mutex> lock(lastFrameMutex_);
-    return lastFrame_.clone();  // Возвращаем копию последнего кадра
+void Sender::rememberFrame(const FrameMeta& frame, std::shared_ptr<const std::vector<uchar>> data) {
+    std::lock_guard<std::mutex> lock(retransmitMutex_);
+    RetransmitEntry& entry = retransmitRing_[frame.frameSeq % retransmitRing_.size()];
+    entry.frame = frame;
+    entry.data = std::move(data);
+    entry.lastResent.assign(frame.totalChunks, std::chrono::steady_clock::time_point());
 }
 
-void Sender::startControlListener() {
-    controlThread_ = std::thread([this]() {
-        int controlSock = socket(AF_INET, SOCK_DGRAM, 0);
-        if (controlSock < 0) {
-            perror("control socket failed");
-            return;
-        }
+namespace {
 
-        sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(5050);  // Порт для получения heartbeats
-        addr.sin_addr.s_addr = INADDR_ANY;
+// Читает десятичное число не больше max до первого нецифрового символа, сдвигая view
+bool parseNumber(std::string_view& text, uint32_t& value, uint32_t max = 0xffff) {
+    size_t i = 0;
+    uint64_t result = 0;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9' && result <= max) {
+        result = result * 10 + (text[i] - '0');
+        ++i;
+    }
+    text.remove_prefix(i);
+    value = static_cast<uint32_t>(result);
+    return i > 0 && result <= max;
+}
 
-        if (bind(controlSock, (sockaddr*)&addr, sizeof(addr)) < 0) {
-            perror("bind failed for control socket");
-            close(controlSock);
-            return;
-        }
+}  // namespace
 
-        struct timeval tv;
-        tv.tv_sec = 1;  // таймаут в 1 секунду
-        tv.tv_usec = 0;
-        setsockopt(controlSock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+void Sender::handleNack(std::string_view message) {
+    // NACK:<clientID>:<frame_seq>:<from>-<to>,<from>-<to>,...
+    nacksReceived_.fetch_add(1, std::memory_order_relaxed);
+    message.remove_prefix(NACK_PREFIX_LEN);
+    size_t pos = message.find(':');
+    if (pos == std::string_view::npos) return;
+    message.remove_prefix(pos + 1);
 
-        char buffer[1024];
-        while (isStreaming_) {
-            sockaddr_in clientAddr{};
-            socklen_t len = sizeof(clientAddr);
-            ssize_t n =
-                recvfrom(controlSock, buffer, sizeof(buffer) - 1, 0, (sockaddr*)&clientAddr, &len);
-            if (n > 0) {
-                buffer[n] = '\0';
-
-                // Извлекаем ID из heartbeat
-                std::string heartbeat(buffer);
-                size_t delimiterPos = heartbeat.find(":");
-                if (delimiterPos != std::string::npos) {
-                    std::string clientID = heartbeat.substr(delimiterPos + 1);
-
-                    {
-                        std::lock_guard<std::mutex> lock(clientMutex_);
-                        clientHeartbeats_[clientID] =
-                            std::chrono::steady_clock::now();  // Обновляем время последнего
-                                                               // heartbeat
-                    }
-
-                    std::cout << "[CONTROL] Heartbeat from client " << clientID << std::endl;
-                    activeClientCount_ = clientHeartbeats_.size();  // Обновляем количество активных
-                                                                    // клиентов
+    uint32_t frame_seq;
+    if (!parseNumber(message, frame_seq, UINT32_MAX) || message.empty() || message[0] != ':') {
+        return;
+    }
+    message.remove_prefix(1);
+
+    std::shared_ptr<const std::vector<uchar>> data;
+    uint16_t total = 0;
+    auto now = std::chrono::steady_clock::now();
+    auto suppression = std::chrono::milliseconds(config_.nackSuppressionMs);
+    {
+        std::lock_guard<std::mutex> lock(retransmitMutex_);
+        RetransmitEntry* entry = &retransmitRing_[frame_seq % retransmitRing_.size()];
+        if (!entry->data || entry->frame.frameSeq != frame_seq) return;  // кадр уже вытеснен
+
+        data = entry->data;
+        total = entry->frame.totalChunks;
+        resetBatch(retransmitBatch_, total);
+
+        uint32_t from, to;
+        while (!message.empty() && parseNumber(message, from)) {
+            to = from;
+            if (!message.empty() && message[0] == '-') {
+                message.remove_prefix(1);
+                if (!parseNumber(message, to)) break;
+            }
+            for (uint32_t chunk = from; chunk <= to && chunk < total; ++chunk) {
+                auto& last = entry->lastResent[chunk];
+                if (now - last < suppression) {
+                    suppressedRetransmits_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
                 }
+                if (retransmitBatch_.count == total) break;
+                last = now;
+                size_t offset = chunk * chunkSize_;
+                addChunkMessage(retransmitBatch_, entry->frame, CHUNK_FLAG_RETRANSMIT,
+                                static_cast<uint16_t>(chunk), data->data() + offset,
+                                std::min(chunkSize_, data->size() - offset));
             }
+            if (message.empty() || message[0] != ',') break;
+            message.remove_prefix(1);
         }
+    }
 
-        close(controlSock);
-    });
+    // data удерживает буфер кадра, пока пачка не отправлена
+    retransmittedPackets_.fetch_add(retransmitBatch_.count, std::memory_order_relaxed);
+    flushBatch(retransmitBatch_, retransmitCounters_);
 }
 
-void Sender::cleanupInactiveClients() {
-    std::cout << "[CONTROL] Cleaning up inactive clients..." << std::endl;
-    auto now = std::chrono::steady_clock::now();
-    std::vector<std::string> to_remove;
+cv::Mat Sender::getPreviewFrame() {
+    FrameHandle frame = previewFrame_.load();
+    return frame ? frame->image.clone() : cv::Mat();  // Возвращаем копию последнего кадра
+}
 
-    {
-        std::lock_guard<std::mutex> lock(clientMutex_);
-        for (auto& [clientID, lastHeartbeat] : clientHeartbeats_) {
-            auto elapsed =
-                std::chrono::duration_cast<std::chrono::seconds>(now - lastHeartbeat).count();
-            if (elapsed >
-                3) {  // если не получен heartbeat больше 3 секунд, считаем клиента неактивным
-                to_remove.push_back(clientID);
+FrameHandle Sender::getPreviewFrameHandle() const { return previewFrame_.load(); }
+
+void Sender::startControlListener() {
+    controlThread_ = std::thread(&Sender::controlLoop, this);
+}
+
+void Sender::controlLoop() {
+    // Буферы пачки выделяются один раз; в каждом место под завершающий ноль
+    std::vector<char> buffers(CONTROL_BATCH_SIZE * CONTROL_MESSAGE_SIZE);
+    std::vector<iovec> iovecs(CONTROL_BATCH_SIZE);
+    std::vector<mmsghdr> messages(CONTROL_BATCH_SIZE);
+    while (isStreaming_) {
+        for (size_t i = 0; i < CONTROL_BATCH_SIZE; ++i) {
+            iovecs[i] = {buffers.data() + i * CONTROL_MESSAGE_SIZE, CONTROL_MESSAGE_SIZE - 1};
+            memset(&messages[i].msg_hdr, 0, sizeof(msghdr));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // Ждёт не дольше тика колеса (см. startStream)
+        int received = transport_->receiveControl(messages.data(), CONTROL_BATCH_SIZE);
+        for (int i = 0; i < received; ++i) {
+            char* buffer = buffers.data() + i * CONTROL_MESSAGE_SIZE;
+            size_t n = messages[i].msg_len;
+            buffer[n] = '\0';
+
+            std::string_view message(buffer, n);
+            if (message.substr(0, NACK_PREFIX_LEN) == NACK_PREFIX) {
+                handleNack(message);
+            } else if (message.substr(0, HEARTBEAT_PREFIX_LEN) == HEARTBEAT_PREFIX) {
+                handleHeartbeat(buffer + HEARTBEAT_PREFIX_LEN);
             }
         }
+
+        clients_.expire(std::chrono::steady_clock::now(), [](uint64_t key) {
+            MULTICAST_LOG_INFO("[CONTROL] Client %016llx is inactive",
+                               static_cast<unsigned long long>(key));
+        });
+    }
+}
+
+void Sender::handleHeartbeat(const char* message) {
+    // <clientID>[:<loss ratio>:<fps>], статистика есть только у новых клиентов.
+    // Разбирается на месте: ID сразу сворачивается в ключ реестра
+    const char* idEnd = strchr(message, ':');
+    std::string_view clientID =
+        idEnd ? std::string_view(message, idEnd - message) : std::string_view(message);
+    if (clientID.empty()) return;
+
+    double lossRatio = 0.0, fps = 0.0;
+    if (idEnd) {
+        char* end = nullptr;
+        lossRatio = strtod(idEnd + 1, &end);
+        if (end && *end == ':') fps = strtod(end + 1, nullptr);
     }
 
-    std::lock_guard<std::mutex> lock(clientMutex_);
-    for (const auto& clientID : to_remove) {
-        clientHeartbeats_.erase(clientID);
-        std::cout << "[CONTROL] Client " << clientID << " is inactive." << std::endl;
+    if (clients_.heartbeat(clientKey(clientID), lossRatio, fps, std::chrono::steady_clock::now())) {
+        MULTICAST_LOG_INFO("[CONTROL] New client %.*s", static_cast<int>(clientID.size()),
+                           clientID.data());
     }
-    activeClientCount_ = clientHeartbeats_.size();  // Обновляем количество активных клиентов
 }
 
-int Sender::getActiveClientCount() const { return activeClientCount_.load(); }
+void Sender::updateRateControl() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - rateWindowStart_).count();
+    if (elapsed <= 0) return;
+
+    uint64_t bytes = transmitCounters_.bytes.load(std::memory_order_relaxed) +
+                     retransmitCounters_.bytes.load(std::memory_order_relaxed);
+    uint64_t frames = transmitCounters_.frames.load(std::memory_order_relaxed);
+    double kbps = (bytes - rateWindowBytes_) * 8.0 / 1000.0 / elapsed;
+    windowFps_.store((frames - rateWindowFrames_) / elapsed, std::memory_order_relaxed);
+    bitrateKbps_.store(kbps, std::memory_order_relaxed);
+    rateWindowStart_ = now;
+    rateWindowBytes_ = bytes;
+    rateWindowFrames_ = frames;
+
+    double worstLoss = clients_.worstLossRatio();
+
+    std::lock_guard<std::mutex> lock(rateMutex_);
+    applyOperatingPoint(rateController_.update(kbps, worstLoss));
+}
+
+void Sender::applyOperatingPoint(const OperatingPoint& point) {
+    jpegQuality_.store(point.jpegQuality, std::memory_order_relaxed);
+    frameScale_.store(point.scale, std::memory_order_relaxed);
+    currentFps_.store(point.fps, std::memory_order_relaxed);
+}
+
+OperatingPoint Sender::getOperatingPoint() {
+    std::lock_guard<std::mutex> lock(rateMutex_);
+    return rateController_.current();
+}
+
+void Sender::setTargetBitrate(int kbps) {
+    std::lock_guard<std::mutex> lock(rateMutex_);
+    rateController_.setTargetBitrate(std::max(0, kbps));
+    // Выключение адаптации сразу возвращает кодер на максимум, не дожидаясь цикла регулятора
+    applyOperatingPoint(rateController_.current());
+}
+
+int Sender::getActiveClientCount() const { return static_cast<int>(clients_.size()); }
+
+PipelineStatistics Sender::getPipelineStatistics() const {
+    PipelineStatistics stats;
+    stats.captureQueueDepth = captureQueue_.size();
+    stats.encodeQueueDepth = encodeQueue_.size();
+    stats.totalFramesCaptured = captureCounters_.frames.load(std::memory_order_relaxed);
+    stats.totalFramesDropped = framesDropped_.load(std::memory_order_relaxed);
+    if (tileEncoder_) {
+        stats.totalTilesSent = tileEncoder_->tilesSent();
+        stats.totalTilesSkipped = tileEncoder_->tilesSkipped();
+    }
+    return stats;
+}
+
+TransmitStatistics Sender::getTransmitStatistics() const {
+    TransmitStatistics stats;
+    stats.totalFramesSent = transmitCounters_.frames.load(std::memory_order_relaxed);
+    stats.totalPacketsSent = transmitCounters_.packets.load(std::memory_order_relaxed) +
+                             retransmitCounters_.packets.load(std::memory_order_relaxed);
+    stats.totalBytesSent = transmitCounters_.bytes.load(std::memory_order_relaxed) +
+                           retransmitCounters_.bytes.load(std::memory_order_relaxed);
+    stats.totalSyscalls = transmitCounters_.syscalls.load(std::memory_order_relaxed) +
+                          retransmitCounters_.syscalls.load(std::memory_order_relaxed);
+    stats.totalSendErrors = transmitCounters_.errors.load(std::memory_order_relaxed) +
+                            retransmitCounters_.errors.load(std::memory_order_relaxed);
+    stats.totalNacksReceived = nacksReceived_.load(std::memory_order_relaxed);
+    stats.totalRetransmittedPackets = retransmittedPackets_.load(std::memory_order_relaxed);
+    stats.totalSuppressedRetransmits = suppressedRetransmits_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+SenderStatistics Sender::getStatistics() const {
+    // Собирается из тех же счётчиков, что и частные статистики, без блокировок
+    PipelineStatistics pipeline = getPipelineStatistics();
+    TransmitStatistics transmit = getTransmitStatistics();
+
+    SenderStatistics stats;
+    stats.totalFramesCaptured = pipeline.totalFramesCaptured;
+    stats.totalCaptureFailures = captureCounters_.failures.load(std::memory_order_relaxed);
+    stats.totalCaptureStalls = captureCounters_.stalls.load(std::memory_order_relaxed);
+    stats.totalFramesDropped = pipeline.totalFramesDropped;
+    stats.totalFramesEncoded = encodeCounters_.frames.load(std::memory_order_relaxed);
+    stats.totalEncodeFailures = encodeCounters_.failures.load(std::memory_order_relaxed);
+    stats.totalFramesSent = transmit.totalFramesSent;
+    stats.totalPacketsSent = transmit.totalPacketsSent;
+    stats.totalBytesSent = transmit.totalBytesSent;
+    stats.totalSyscalls = transmit.totalSyscalls;
+    stats.totalSendErrors = transmit.totalSendErrors;
+    stats.totalSendWouldBlock = transmitCounters_.wouldBlock.load(std::memory_order_relaxed) +
+                                retransmitCounters_.wouldBlock.load(std::memory_order_relaxed);
+    stats.totalNacksReceived = transmit.totalNacksReceived;
+    stats.totalRetransmittedPackets = transmit.totalRetransmittedPackets;
+    stats.totalSuppressedRetransmits = transmit.totalSuppressedRetransmits;
+    stats.totalTilesSent = pipeline.totalTilesSent;
+    stats.totalTilesSkipped = pipeline.totalTilesSkipped;
+    stats.captureQueueDepth = pipeline.captureQueueDepth;
+    stats.encodeQueueDepth = pipeline.encodeQueueDepth;
+    stats.activeClients = static_cast<int>(clients_.size());
+    stats.windowFps = windowFps_.load(std::memory_order_relaxed);
+    stats.bitrateKbps = bitrateKbps_.load(std::memory_order_relaxed);
+
+    stats.lastFrameSize = encodeCounters_.lastFrameSize.load(std::memory_order_relaxed);
+    uint64_t encodedBytes = encodeCounters_.bytes.load(std::memory_order_relaxed);
+    if (stats.totalFramesEncoded > 0) {
+        stats.avgFrameSize = double(encodedBytes) / stats.totalFramesEncoded;
+    }
+    uint64_t dataPackets = transmitCounters_.dataPackets.load(std::memory_order_relaxed);
+    if (stats.totalFramesSent > 0) {
+        stats.avgPacketsPerFrame = double(dataPackets) / stats.totalFramesSent;
+    }
+
+    stats.captureLatency = captureLatency_.summary();
+    stats.encodeLatency = encodeLatency_.summary();
+    stats.transmitLatency = transmitLatency_.summary();
+    stats.captureToSendLatency = captureToSendLatency_.summary();
+    return stats;
+}
 
 }  // namespace MulticastLib
@@ -0,0 +1,62 @@
+#include "strip_encoder.h"
+
+#include <algorithm>
+
+#include "protocol.h"
+
+// Высота полосы кратна MCU при субдискретизации 4:2:0, чтобы границы полос не
+// отличались по качеству от границ блоков внутри полосы
+#define STRIP_ALIGNMENT 16
+
+namespace MulticastLib {
+
+StripEncoder::StripEncoder(int stripCount, int threadCount)
+    : stripCount_(std::max(1, stripCount)), pool_(std::max(1, threadCount)) {
+    for (size_t i = 0; i < pool_.size(); ++i) {
+        encoders_.push_back(std::make_unique<JpegEncoder>());
+    }
+}
+
+bool StripEncoder::encode(const cv::Mat& frame, int quality, std::vector<uchar>& out,
+                          uint8_t* flags, size_t alignment) {
+    out.clear();
+    if (frame.empty()) return false;
+
+    int stripHeight = (frame.rows + stripCount_ - 1) / stripCount_;
+    stripHeight = (stripHeight + STRIP_ALIGNMENT - 1) / STRIP_ALIGNMENT * STRIP_ALIGNMENT;
+    strips_.clear();
+    for (int y = 0; y < frame.rows; y += stripHeight) {
+        strips_.emplace_back(0, y, frame.cols, std::min(stripHeight, frame.rows - y));
+    }
+    if (jpegs_.size() < strips_.size()) jpegs_.resize(strips_.size());
+    encoded_.assign(strips_.size(), 0);
+
+    pool_.run(strips_.size(), [&](size_t strip, size_t worker) {
+        encoded_[strip] = encoders_[worker]->encode(frame(strips_[strip]), quality, jpegs_[strip]);
+    });
+
+    // Склейка по порядку полос; полоса, которую не удалось сжать, ломает весь кадр
+    for (size_t i = 0; i < strips_.size(); ++i) {
+        if (!encoded_[i]) {
+            out.clear();
+            return false;
+        }
+        // Выравнивание нулями: в среднем полчанка на полосу
+        if (alignment > 0 && i > 0) {
+            out.resize((out.size() + alignment - 1) / alignment * alignment);
+        }
+
+        SegmentHeader header;
+        header.x = 0;
+        header.y = static_cast<uint16_t>(strips_[i].y);
+        header.width = static_cast<uint16_t>(strips_[i].width);
+        header.height = static_cast<uint16_t>(strips_[i].height);
+        header.frame_width = static_cast<uint16_t>(frame.cols);
+        header.frame_height = static_cast<uint16_t>(frame.rows);
+        appendSegment(out, header, jpegs_[i].data(), jpegs_[i].size());
+    }
+    *flags = CHUNK_FLAG_SEGMENTED | (alignment > 0 ? CHUNK_FLAG_ALIGNED : 0);
+    return true;
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,180 @@
+#include "tile_delta.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "protocol.h"
+
+// Пустой дельта-кадр для статичной сцены - заметно чаще, чем LISTENING_TIMEOUT_S приёмника
+#define TILE_KEEPALIVE_INTERVAL_MS 500
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SAD_HAVE_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SAD_HAVE_NEON 1
+#endif
+
+namespace MulticastLib {
+
+namespace {
+
+uint64_t sadScalar(const uint8_t* a, const uint8_t* b, size_t len) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < len; ++i) sum += std::abs(int(a[i]) - int(b[i]));
+    return sum;
+}
+
+#if defined(SAD_HAVE_X86)
+#if defined(__SSE2__)
+uint64_t sadSse2(const uint8_t* a, const uint8_t* b, size_t len) {
+    // psadbw: суммы модулей разностей по 8 байт в двух 64-битных половинах
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(x, y));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    return lanes[0] + lanes[1] + sadScalar(a + i, b + i, len - i);
+}
+#endif
+
+__attribute__((target("avx2"))) uint64_t sadAvx2(const uint8_t* a, const uint8_t* b,
+                                                 size_t len) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(x, y));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sadScalar(a + i, b + i, len - i);
+}
+#endif
+
+#if defined(SAD_HAVE_NEON)
+uint64_t sadNeon(const uint8_t* a, const uint8_t* b, size_t len) {
+    // |a-b| попарно складывается в 16-, затем в 32-битные лейны
+    uint32x4_t acc = vdupq_n_u32(0);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+    }
+    uint64x2_t sum = vpaddlq_u32(acc);
+    return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1) + sadScalar(a + i, b + i, len - i);
+}
+#endif
+
+using SadKernel = uint64_t (*)(const uint8_t*, const uint8_t*, size_t);
+
+SadKernel selectKernel() {
+#if defined(SAD_HAVE_X86)
+    if (__builtin_cpu_supports("avx2")) return sadAvx2;
+#if defined(__SSE2__)
+    return sadSse2;
+#endif
+#elif defined(SAD_HAVE_NEON)
+    return sadNeon;
+#endif
+    return sadScalar;
+}
+
+}  // namespace
+
+uint64_t sumAbsDiff(const uint8_t* a, const uint8_t* b, size_t len) {
+    static const SadKernel kernel = selectKernel();
+    return kernel(a, b, len);
+}
+
+TileDeltaEncoder::TileDeltaEncoder(int tileSize, double changeThreshold, int refreshInterval)
+    : tileSize_(std::max(16, tileSize)),
+      changeThreshold_(std::max(0.0, changeThreshold)),
+      refreshInterval_(std::max(1, refreshInterval)),
+      framesSinceRefresh_(refreshInterval_) {}
+
+bool TileDeltaEncoder::tileChanged(const cv::Mat& frame, const cv::Rect& tile) const {
+    // Строки тайла не лежат подряд - сравниваем построчно
+    const size_t rowBytes = static_cast<size_t>(tile.width) * frame.elemSize();
+    const uint64_t limit = static_cast<uint64_t>(changeThreshold_ * rowBytes * tile.height);
+    uint64_t sad = 0;
+    for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        const uint8_t* current = frame.ptr(y) + tile.x * frame.elemSize();
+        const uint8_t* previous = reference_.ptr(y) + tile.x * frame.elemSize();
+        sad += sumAbsDiff(current, previous, rowBytes);
+        if (sad > limit) return true;
+    }
+    return false;
+}
+
+void TileDeltaEncoder::appendSegment(std::vector<uchar>& out, const cv::Mat& frame,
+                                     const cv::Rect& tile) {
+    jpegEncoder_.encode(frame(tile), quality_, jpeg_);
+
+    SegmentHeader header;
+    header.x = static_cast<uint16_t>(tile.x);
+    header.y = static_cast<uint16_t>(tile.y);
+    header.width = static_cast<uint16_t>(tile.width);
+    header.height = static_cast<uint16_t>(tile.height);
+    header.frame_width = static_cast<uint16_t>(frame.cols);
+    header.frame_height = static_cast<uint16_t>(frame.rows);
+    MulticastLib::appendSegment(out, header, jpeg_.data(), jpeg_.size());
+}
+
+bool TileDeltaEncoder::encode(const cv::Mat& frame, int quality, std::vector<uchar>& out,
+                              uint8_t* flags) {
+    quality_ = quality;
+    out.clear();
+
+    // Смена размера (например, регулятором битрейта) тоже требует полного кадра
+    bool refresh = refreshRequested_.exchange(false, std::memory_order_acq_rel) ||
+                   framesSinceRefresh_ >= refreshInterval_ || reference_.size() != frame.size() ||
+                   reference_.type() != frame.type();
+    framesSinceRefresh_ = refresh ? 1 : framesSinceRefresh_ + 1;
+    if (refresh) frame.copyTo(reference_);
+
+    uint64_t sent = 0, skipped = 0;
+    for (int y = 0; y < frame.rows; y += tileSize_) {
+        for (int x = 0; x < frame.cols; x += tileSize_) {
+            cv::Rect tile(x, y, std::min(tileSize_, frame.cols - x),
+                          std::min(tileSize_, frame.rows - y));
+            if (!refresh) {
+                if (!tileChanged(frame, tile)) {
+                    skipped++;
+                    continue;
+                }
+                frame(tile).copyTo(reference_(tile));
+            }
+            appendSegment(out, frame, tile);
+            sent++;
+        }
+    }
+
+    tilesSent_.fetch_add(sent, std::memory_order_relaxed);
+    tilesSkipped_.fetch_add(skipped, std::memory_order_relaxed);
+    *flags = CHUNK_FLAG_SEGMENTED | (refresh ? 0 : CHUNK_FLAG_DELTA);
+
+    // Ничего не изменилось: изредка шлём один сегмент без JPEG. Приёмник его не рисует,
+    // но видит, что поток жив
+    auto now = std::chrono::steady_clock::now();
+    if (sent == 0) {
+        if (now - lastEmitted_ < std::chrono::milliseconds(TILE_KEEPALIVE_INTERVAL_MS)) {
+            return false;
+        }
+        SegmentHeader header{};
+        header.frame_width = static_cast<uint16_t>(frame.cols);
+        header.frame_height = static_cast<uint16_t>(frame.rows);
+        const uint8_t none = 0;
+        MulticastLib::appendSegment(out, header, &none, 0);
+    }
+    lastEmitted_ = now;
+    return true;
+}
+
+}  // namespace MulticastLib
@@ -0,0 +1,463 @@
+#include "transport.h"
+
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include "logging.h"
+#include "protocol.h"
+#include "uring_transport.h"
+
+// Опции сокета из linux/udp.h, которых нет в заголовках старых glibc
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// Ограничения ядра на одну склейку GSO: число датаграмм (UDP_MAX_SEGMENTS) и длина
+// UDP-нагрузки в одном IPv4-пакете
+#define GSO_MAX_SEGMENTS 64
+#define GSO_MAX_BYTES (65535 - IPV4_UDP_OVERHEAD)
+#define GSO_CONTROL_SIZE CMSG_SPACE(sizeof(uint16_t))
+// Склеенных буферов на один recvmmsg с GRO, каждый - на целую склейку
+#define GRO_BUFFERS 8
+#define GRO_BUFFER_SIZE 65535
+#define GRO_CONTROL_SIZE CMSG_SPACE(sizeof(int))
+
+namespace MulticastLib {
+
+namespace {
+
+timeval toTimeval(std::chrono::microseconds timeout) {
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+    tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000000);
+    return tv;
+}
+
+size_t datagramLength(const msghdr& msg) {
+    size_t len = 0;
+    for (size_t i = 0; i < msg.msg_iovlen; ++i) len += msg.msg_iov[i].iov_len;
+    return len;
+}
+
+// Длина датаграмм склейки из UDP_GRO, 0 - датаграмма пришла одна
+size_t groSegmentSize(msghdr& msg) {
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size > 0 ? static_cast<size_t>(size) : 0;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+UdpSenderTransport::UdpSenderTransport(const std::string& multicastAddress, int port,
+                                       bool segmentationOffload)
+    : multicastIP_(multicastAddress), port_(port), segmentationOffload_(segmentationOffload) {}
+
+UdpSenderTransport::~UdpSenderTransport() { close(); }
+
+bool UdpSenderTransport::open(std::chrono::microseconds controlTimeout) {
+    close();
+    controlTimeout_ = controlTimeout;
+
+    // Создание и конфигурация сокета
+    sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd_ < 0) {
+        MULTICAST_LOG_ERROR("Failed to create socket: %s", strerror(errno));
+        return false;
+    }
+
+    // time to live для мультикаст пакетов = 1 позволяет доставлять пакеты только локально
+    int ttl = 1;
+    if (setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+        MULTICAST_LOG_ERROR("setsockopt IP_MULTICAST_TTL failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    // Ядра до 4.18 не знают UDP_SEGMENT; нулевой размер сам по себе склейку не включает
+    gso_.store(false, std::memory_order_relaxed);
+    if (segmentationOffload_) {
+        int size = 0;
+        if (setsockopt(sockfd_, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) == 0) {
+            gso_.store(true, std::memory_order_relaxed);
+            MULTICAST_LOG_INFO("UDP segmentation offload enabled");
+        } else {
+            MULTICAST_LOG_WARNING("UDP GSO unavailable (%s), sending datagrams one by one",
+                                  strerror(errno));
+        }
+    }
+
+    memset(&multicastAddr_, 0, sizeof(multicastAddr_));
+    multicastAddr_.sin_family = AF_INET;
+    multicastAddr_.sin_addr.s_addr = inet_addr(multicastIP_.c_str());
+    multicastAddr_.sin_port = htons(port_);
+
+    controlSockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (controlSockfd_ < 0) {
+        MULTICAST_LOG_ERROR("control socket failed: %s", strerror(errno));
+        return true;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(CONTROL_PORT);  // Порт для получения heartbeats
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(controlSockfd_, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        MULTICAST_LOG_ERROR("bind failed for control socket: %s", strerror(errno));
+        ::close(controlSockfd_);
+        controlSockfd_ = -1;
+        return true;
+    }
+
+    timeval tv = toTimeval(controlTimeout);
+    setsockopt(controlSockfd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return true;
+}
+
+void UdpSenderTransport::close() {
+    if (sockfd_ != -1) {
+        ::close(sockfd_);
+        sockfd_ = -1;
+    }
+    if (controlSockfd_ != -1) {
+        ::close(controlSockfd_);
+        controlSockfd_ = -1;
+    }
+}
+
+int UdpSenderTransport::sendBatch(struct mmsghdr* messages, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        messages[i].msg_hdr.msg_name = &multicastAddr_;
+        messages[i].msg_hdr.msg_namelen = sizeof(multicastAddr_);
+    }
+    if (!gso_.load(std::memory_order_relaxed)) return sendMessages(messages, count);
+
+    std::lock_guard<std::mutex> lock(gsoMutex_);
+    unsigned int runs = coalesceBatch(messages, count);
+    int sent = sendMessages(gsoMessages_.data(), runs);
+    if (sent < 0) {
+        // Ядро знает UDP_SEGMENT, но маршрут не умеет: интерфейс без checksum offload - EIO,
+        // датаграмма больше MTU интерфейса (склейку нельзя фрагментировать) - EMSGSIZE
+        if (errno != EIO && errno != EMSGSIZE && errno != EINVAL && errno != EOPNOTSUPP) {
+            return -1;
+        }
+        MULTICAST_LOG_WARNING("UDP GSO rejected (%s), sending datagrams one by one",
+                              strerror(errno));
+        gso_.store(false, std::memory_order_relaxed);
+        return sendMessages(messages, count);
+    }
+
+    // Склейка уходит целиком или не уходит вовсе
+    unsigned int done = 0;
+    for (int run = 0; run < sent; ++run) done += gsoRuns_[run];
+    for (unsigned int i = 0; i < done; ++i) {
+        messages[i].msg_len = static_cast<unsigned int>(datagramLength(messages[i].msg_hdr));
+    }
+    return static_cast<int>(done);
+}
+
+int UdpSenderTransport::sendMessages(struct mmsghdr* messages, unsigned int count) {
+    return sendmmsg(sockfd_, messages, count, 0);
+}
+
+unsigned int UdpSenderTransport::coalesceBatch(struct mmsghdr* messages, unsigned int count) {
+    // iovec'и склейки должны идти подряд, поэтому копируем их в один массив
+    size_t iovecs = 0;
+    for (unsigned int i = 0; i < count; ++i) iovecs += messages[i].msg_hdr.msg_iovlen;
+    gsoIovecs_.resize(iovecs);
+    gsoMessages_.resize(count);
+    gsoRuns_.resize(count);
+    gsoControl_.resize(count * GSO_CONTROL_SIZE);
+
+    // Склейка - датаграммы одной длины, последняя может быть короче (хвост кадра)
+    unsigned int runs = 0;
+    size_t iov = 0;
+    unsigned int i = 0;
+    while (i < count) {
+        const unsigned int first = i;
+        const size_t firstIov = iov;
+        const size_t segment = datagramLength(messages[i].msg_hdr);
+        size_t total = 0;
+        while (i < count && i - first < GSO_MAX_SEGMENTS) {
+            const msghdr& msg = messages[i].msg_hdr;
+            size_t len = datagramLength(msg);
+            if (len > segment || total + len > GSO_MAX_BYTES) break;
+            std::copy(msg.msg_iov, msg.msg_iov + msg.msg_iovlen, &gsoIovecs_[iov]);
+            iov += msg.msg_iovlen;
+            total += len;
+            ++i;
+            if (len < segment) break;
+        }
+
+        msghdr& msg = gsoMessages_[runs].msg_hdr;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &multicastAddr_;
+        msg.msg_namelen = sizeof(multicastAddr_);
+        msg.msg_iov = &gsoIovecs_[firstIov];
+        msg.msg_iovlen = iov - firstIov;
+        if (i - first > 1) {
+            msg.msg_control = &gsoControl_[runs * GSO_CONTROL_SIZE];
+            msg.msg_controllen = GSO_CONTROL_SIZE;
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            auto size = static_cast<uint16_t>(segment);
+            memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+        }
+        gsoRuns_[runs++] = i - first;
+    }
+    return runs;
+}
+
+int UdpSenderTransport::receiveControl(struct mmsghdr* messages, unsigned int count) {
+    // Без сокета управляющий поток всё равно просыпается с тем же периодом
+    if (controlSockfd_ < 0) {
+        std::this_thread::sleep_for(controlTimeout_);
+        return 0;
+    }
+    int received = recvmmsg(controlSockfd_, messages, count, MSG_WAITFORONE, nullptr);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+    return received;
+}
+
+UdpReceiverTransport::UdpReceiverTransport(const std::string& multicastAddress, int port,
+                                           int recvBufferSize, bool receiveOffload)
+    : multicastIP_(multicastAddress),
+      port_(port),
+      recvBufferSize_(recvBufferSize),
+      receiveOffload_(receiveOffload) {}
+
+UdpReceiverTransport::~UdpReceiverTransport() { close(); }
+
+bool UdpReceiverTransport::open(std::chrono::microseconds receiveTimeout) {
+    close();
+    sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd_ < 0) {
+        MULTICAST_LOG_ERROR("socket failed: %s", strerror(errno));
+        return false;
+    }
+
+    timeval tv = toTimeval(receiveTimeout);
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+        MULTICAST_LOG_ERROR("setsockopt SO_RCVTIMEO failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    int reuse = 1;
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0) {
+        MULTICAST_LOG_ERROR("setsockopt SO_REUSEADDR failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+        MULTICAST_LOG_ERROR("setsockopt SO_REUSEPORT failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    // SO_RCVBUFFORCE обходит net.core.rmem_max, но требует CAP_NET_ADMIN
+    int rcvbuf = recvBufferSize_;
+    if (rcvbuf > 0 &&
+        setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0 &&
+        setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        MULTICAST_LOG_ERROR("setsockopt SO_RCVBUF failed: %s", strerror(errno));
+    }
+
+    sockaddr_in localAddr{};
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    localAddr.sin_port = htons(port_);
+    if (bind(sockfd_, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
+        MULTICAST_LOG_ERROR("bind failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    controlSockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (controlSockfd_ < 0) {
+        MULTICAST_LOG_ERROR("control socket failed: %s", strerror(errno));
+    }
+    hasControlAddr_ = false;
+    syscalls_.store(0, std::memory_order_relaxed);
+
+    // UDP_GRO - ядро 5.0+; без него датаграммы приходят по одной
+    gro_ = false;
+    groReceived_ = 0;
+    groNext_ = 0;
+    groOffset_ = 0;
+    if (receiveOffload_) {
+        int gro = 1;
+        if (setsockopt(sockfd_, SOL_UDP, UDP_GRO, &gro, sizeof(gro)) == 0) {
+            gro_ = true;
+            groBuffers_.resize(GRO_BUFFERS * GRO_BUFFER_SIZE);
+            groControl_.resize(GRO_BUFFERS * GRO_CONTROL_SIZE);
+            groIovecs_.resize(GRO_BUFFERS);
+            groMessages_.resize(GRO_BUFFERS);
+            MULTICAST_LOG_INFO("UDP receive offload enabled");
+        } else {
+            MULTICAST_LOG_WARNING("UDP GRO unavailable (%s), receiving datagrams one by one",
+                                  strerror(errno));
+        }
+    }
+
+    mreq_.imr_multiaddr.s_addr = inet_addr(multicastIP_.c_str());
+    mreq_.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(sockfd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq_, sizeof(mreq_)) < 0) {
+        MULTICAST_LOG_ERROR("setsockopt IP_ADD_MEMBERSHIP failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UdpReceiverTransport::close() {
+    if (sockfd_ != -1) {
+        ::close(sockfd_);
+        sockfd_ = -1;
+    }
+    if (controlSockfd_ != -1) {
+        ::close(controlSockfd_);
+        controlSockfd_ = -1;
+    }
+}
+
+void UdpReceiverTransport::wake() {
+    // shutdown будит поток, заблокированный в recvmmsg
+    if (sockfd_ != -1) shutdown(sockfd_, SHUT_RDWR);
+}
+
+int UdpReceiverTransport::receiveBatch(struct mmsghdr* messages, unsigned int count) {
+    if (gro_) return receiveCoalesced(messages, count);
+    sourceAddrs_.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        messages[i].msg_hdr.msg_name = &sourceAddrs_[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+
+    // MSG_WAITFORONE: блокируемся до первой датаграммы, остальное забираем без ожидания
+    int received = recvmmsg(sockfd_, messages, count, MSG_WAITFORONE, nullptr);
+    syscalls_.store(syscalls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (received > 0) rememberSource(sourceAddrs_[received - 1]);
+    return received;
+}
+
+int UdpReceiverTransport::receiveCoalesced(struct mmsghdr* messages, unsigned int count) {
+    // Новый recvmmsg - только когда отданы все датаграммы прошлых склеек
+    if (groNext_ >= groReceived_) {
+        unsigned int buffers = std::min<unsigned int>(count, GRO_BUFFERS);
+        sourceAddrs_.resize(std::max<size_t>(sourceAddrs_.size(), buffers));
+        for (unsigned int i = 0; i < buffers; ++i) {
+            groIovecs_[i] = {&groBuffers_[i * GRO_BUFFER_SIZE], GRO_BUFFER_SIZE};
+            msghdr& msg = groMessages_[i].msg_hdr;
+            msg.msg_name = &sourceAddrs_[i];
+            msg.msg_namelen = sizeof(sockaddr_in);
+            msg.msg_iov = &groIovecs_[i];
+            msg.msg_iovlen = 1;
+            msg.msg_control = &groControl_[i * GRO_CONTROL_SIZE];
+            msg.msg_controllen = GRO_CONTROL_SIZE;
+            msg.msg_flags = 0;
+        }
+        int received = recvmmsg(sockfd_, groMessages_.data(), buffers, MSG_WAITFORONE, nullptr);
+        syscalls_.store(syscalls_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        if (received <= 0) return received;
+        rememberSource(sourceAddrs_[received - 1]);
+        groReceived_ = static_cast<unsigned int>(received);
+        groNext_ = 0;
+        groOffset_ = 0;
+    }
+
+    // Склейка режется на датаграммы по размеру из UDP_GRO, последняя может быть короче.
+    // Датаграммы остаются в буфере склейки, без копирования в буфер Receiver'а
+    unsigned int out = 0;
+    while (out < count && groNext_ < groReceived_) {
+        mmsghdr& coalesced = groMessages_[groNext_];
+        size_t total = coalesced.msg_len;
+        size_t segment = groSegmentSize(coalesced.msg_hdr);
+        if (segment == 0) segment = total;
+        size_t step = std::min(segment, total - groOffset_);
+
+        msghdr& msg = messages[out].msg_hdr;
+        size_t len = step;
+        msg.msg_flags = coalesced.msg_hdr.msg_flags & MSG_TRUNC;
+        if (len > msg.msg_iov[0].iov_len) {
+            len = msg.msg_iov[0].iov_len;
+            msg.msg_flags |= MSG_TRUNC;
+        }
+        msg.msg_iov[0].iov_base = &groBuffers_[groNext_ * GRO_BUFFER_SIZE + groOffset_];
+        msg.msg_iov[0].iov_len = len;
+        messages[out].msg_len = static_cast<unsigned int>(len);
+        ++out;
+
+        groOffset_ += step;
+        if (groOffset_ >= total) {
+            ++groNext_;
+            groOffset_ = 0;
+        }
+    }
+    return static_cast<int>(out);
+}
+
+void UdpReceiverTransport::disableReceiveOffload() {
+    if (!gro_) return;
+    int gro = 0;
+    setsockopt(sockfd_, SOL_UDP, UDP_GRO, &gro, sizeof(gro));
+    gro_ = false;
+    MULTICAST_LOG_INFO("UDP receive offload disabled");
+}
+
+void UdpReceiverTransport::rememberSource(const sockaddr_in& source) {
+    controlAddr_ = source;
+    controlAddr_.sin_port = htons(CONTROL_PORT);  // управляющий порт Sender’а
+    hasControlAddr_ = true;
+}
+
+uint64_t UdpReceiverTransport::syscallCount() const {
+    return syscalls_.load(std::memory_order_relaxed);
+}
+
+bool UdpReceiverTransport::sendControl(const void* data, size_t len) {
+    if (controlSockfd_ < 0 || !hasControlAddr_) return false;
+    return sendto(controlSockfd_, data, len, 0, (sockaddr*)&controlAddr_,
+                  sizeof(controlAddr_)) >= 0;
+}
+
+std::unique_ptr<SenderTransport> makeUdpSenderTransport(const std::string& multicastAddress,
+                                                        int port, IoBackend backend,
+                                                        bool segmentationOffload) {
+    if (backend == IoBackend::IoUring) {
+        return std::make_unique<UringSenderTransport>(multicastAddress, port,
+                                                      segmentationOffload);
+    }
+    return std::make_unique<UdpSenderTransport>(multicastAddress, port, segmentationOffload);
+}
+
+std::unique_ptr<ReceiverTransport> makeUdpReceiverTransport(const std::string& multicastAddress,
+                                                            int port, int recvBufferSize,
+                                                            IoBackend backend,
+                                                            bool receiveOffload) {
+    if (backend == IoBackend::IoUring) {
+        return std::make_unique<UringReceiverTransport>(multicastAddress, port, recvBufferSize,
+                                                        receiveOffload);
+    }
+    return std::make_unique<UdpReceiverTransport>(multicastAddress, port, recvBufferSize,
+                                                  receiveOffload);
+}
+
+}  // namespace MulticastLib
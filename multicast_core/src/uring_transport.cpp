@@ -0,0 +1,368 @@
+#include "uring_transport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#if defined(MULTICAST_HAVE_LIBURING)
+#include <liburing.h>
+#endif
+
+#include "logging.h"
+#include "protocol.h"
+
+// Запросов в очереди отправки: не меньше пачки Sender'а (SEND_BATCH_SIZE)
+#define URING_SEND_ENTRIES 128
+// Буферов приёма в кольце (степень двойки). Очередь завершений вдвое больше, чтобы
+// не переполниться, даже если все буферы заполнены
+#define URING_RECV_BUFFERS 512
+#define URING_RECV_ENTRIES 8
+#define URING_BUFFER_GROUP 0
+// user_data завершений приёма: датаграммы и пробуждение из wake()
+#define URING_RECV_TAG 0
+#define URING_WAKE_TAG 1
+
+namespace MulticastLib {
+
+#if defined(MULTICAST_HAVE_LIBURING)
+namespace {
+
+// Буфер приёма: заголовок recvmsg, адрес отправителя и датаграмма до MAX_MTU
+constexpr size_t URING_BUFFER_SIZE =
+    sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + MAX_MTU - IPV4_UDP_OVERHEAD;
+
+void deleteRing(io_uring* ring) {
+    io_uring_queue_exit(ring);
+    delete ring;
+}
+
+}  // namespace
+#endif
+
+bool ioUringSupported() {
+#if defined(MULTICAST_HAVE_LIBURING)
+    static const bool supported = [] {
+        io_uring ring;
+        if (io_uring_queue_init(2, &ring, 0) < 0) return false;
+        io_uring_queue_exit(&ring);
+        return true;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+UringSenderTransport::UringSenderTransport(const std::string& multicastAddress, int port,
+                                           bool segmentationOffload)
+    : UdpSenderTransport(multicastAddress, port, segmentationOffload) {}
+
+UringSenderTransport::~UringSenderTransport() { close(); }
+
+bool UringSenderTransport::open(std::chrono::microseconds controlTimeout) {
+    if (!UdpSenderTransport::open(controlTimeout)) return false;
+#if defined(MULTICAST_HAVE_LIBURING)
+    auto ring = std::make_unique<io_uring>();
+    int ret = io_uring_queue_init(URING_SEND_ENTRIES, ring.get(), 0);
+    if (ret < 0) {
+        MULTICAST_LOG_WARNING("io_uring unavailable (%s), using sendmmsg", strerror(-ret));
+        return true;
+    }
+    // Зарегистрированный сокет: ядро не берёт ссылку на файл на каждую датаграмму
+    ret = io_uring_register_files(ring.get(), &sockfd_, 1);
+    if (ret < 0) {
+        MULTICAST_LOG_WARNING("io_uring file registration failed (%s), using sendmmsg",
+                              strerror(-ret));
+        io_uring_queue_exit(ring.get());
+        return true;
+    }
+    ring_ = ring.release();
+    MULTICAST_LOG_INFO("Sender transport: io_uring");
+#endif
+    return true;
+}
+
+void UringSenderTransport::close() {
+#if defined(MULTICAST_HAVE_LIBURING)
+    if (ring_) {
+        deleteRing(ring_);
+        ring_ = nullptr;
+    }
+#endif
+    UdpSenderTransport::close();
+}
+
+int UringSenderTransport::sendMessages(struct mmsghdr* messages, unsigned int count) {
+#if defined(MULTICAST_HAVE_LIBURING)
+    if (ring_ && count > 0) {
+        std::lock_guard<std::mutex> lock(ringMutex_);
+        count = std::min(count, static_cast<unsigned int>(URING_SEND_ENTRIES));
+        for (unsigned int i = 0; i < count; ++i) {
+            io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+            io_uring_prep_sendmsg(sqe, 0, &messages[i].msg_hdr, 0);
+            sqe->flags |= IOSQE_FIXED_FILE;
+            if (i + 1 < count) sqe->flags |= IOSQE_IO_LINK;
+            io_uring_sqe_set_data64(sqe, i);
+        }
+        int ret = io_uring_submit_and_wait(ring_, count);
+        if (ret < 0) {
+            errno = -ret;
+            return -1;
+        }
+
+        // Отправлено всё до первой ошибки, хвост цепочки ядро отменяет (-ECANCELED)
+        unsigned int sent = count;
+        int error = 0;
+        for (unsigned int done = 0; done < count; ++done) {
+            io_uring_cqe* cqe;
+            ret = io_uring_wait_cqe(ring_, &cqe);
+            if (ret < 0) {
+                errno = -ret;
+                return -1;
+            }
+            auto index = static_cast<unsigned int>(cqe->user_data);
+            if (cqe->res >= 0) {
+                messages[index].msg_len = static_cast<unsigned int>(cqe->res);
+            } else if (index < sent) {
+                sent = index;
+                error = -cqe->res;
+            }
+            io_uring_cqe_seen(ring_, cqe);
+        }
+        if (sent == 0) {
+            errno = error;
+            return -1;
+        }
+        return static_cast<int>(sent);
+    }
+#endif
+    return UdpSenderTransport::sendMessages(messages, count);
+}
+
+UringReceiverTransport::UringReceiverTransport(const std::string& multicastAddress, int port,
+                                               int recvBufferSize, bool receiveOffload)
+    : UdpReceiverTransport(multicastAddress, port, recvBufferSize, receiveOffload) {}
+
+UringReceiverTransport::~UringReceiverTransport() { close(); }
+
+bool UringReceiverTransport::open(std::chrono::microseconds receiveTimeout) {
+    if (!UdpReceiverTransport::open(receiveTimeout)) return false;
+    receiveTimeout_ = receiveTimeout;
+    if (setupRing()) {
+        disableReceiveOffload();
+        MULTICAST_LOG_INFO("Receiver transport: io_uring");
+    }
+    return true;
+}
+
+void UringReceiverTransport::close() {
+    destroyRing();
+    UdpReceiverTransport::close();
+}
+
+bool UringReceiverTransport::setupRing() {
+#if defined(MULTICAST_HAVE_LIBURING)
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 2 * URING_RECV_BUFFERS;
+    auto ring = std::make_unique<io_uring>();
+    int ret = io_uring_queue_init_params(URING_RECV_ENTRIES, ring.get(), &params);
+    if (ret < 0) {
+        MULTICAST_LOG_WARNING("io_uring unavailable (%s), using recvmmsg", strerror(-ret));
+        return false;
+    }
+    io_uring_buf_ring* bufferRing = nullptr;
+    ret = io_uring_register_files(ring.get(), &sockfd_, 1);
+    if (ret == 0) {
+        bufferRing =
+            io_uring_setup_buf_ring(ring.get(), URING_RECV_BUFFERS, URING_BUFFER_GROUP, 0, &ret);
+    }
+    if (!bufferRing) {
+        // Кольцо буферов - ядро 5.19+
+        MULTICAST_LOG_WARNING("io_uring buffer ring failed (%s), using recvmmsg", strerror(-ret));
+        io_uring_queue_exit(ring.get());
+        return false;
+    }
+    int wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd == -1) {
+        MULTICAST_LOG_WARNING("eventfd failed (%s), using recvmmsg", strerror(errno));
+        io_uring_free_buf_ring(ring.get(), bufferRing, URING_RECV_BUFFERS, URING_BUFFER_GROUP);
+        io_uring_queue_exit(ring.get());
+        return false;
+    }
+    ring_ = ring.release();
+    bufferRing_ = bufferRing;
+    wakeFd_ = wakeFd;
+
+    buffers_.resize(URING_RECV_BUFFERS * URING_BUFFER_SIZE);
+    int mask = io_uring_buf_ring_mask(URING_RECV_BUFFERS);
+    for (int i = 0; i < URING_RECV_BUFFERS; ++i) {
+        io_uring_buf_ring_add(bufferRing_, buffers_.data() + i * URING_BUFFER_SIZE,
+                              URING_BUFFER_SIZE, static_cast<uint16_t>(i), mask, i);
+    }
+    io_uring_buf_ring_advance(bufferRing_, URING_RECV_BUFFERS);
+
+    memset(&recvTemplate_, 0, sizeof(recvTemplate_));
+    recvTemplate_.msg_namelen = sizeof(sockaddr_in);
+    armed_ = false;
+    wakeArmed_ = false;
+    received_ = false;
+    lent_.clear();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void UringReceiverTransport::destroyRing() {
+#if defined(MULTICAST_HAVE_LIBURING)
+    if (!ring_) return;
+    if (bufferRing_) {
+        io_uring_free_buf_ring(ring_, bufferRing_, URING_RECV_BUFFERS, URING_BUFFER_GROUP);
+        bufferRing_ = nullptr;
+    }
+    deleteRing(ring_);
+    ring_ = nullptr;
+    if (wakeFd_ != -1) {
+        ::close(wakeFd_);
+        wakeFd_ = -1;
+    }
+    lent_.clear();
+#endif
+}
+
+void UringReceiverTransport::wake() {
+    UdpReceiverTransport::wake();
+    if (wakeFd_ != -1) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd_, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void UringReceiverTransport::recycleBuffers() {
+#if defined(MULTICAST_HAVE_LIBURING)
+    if (lent_.empty()) return;
+    int mask = io_uring_buf_ring_mask(URING_RECV_BUFFERS);
+    for (size_t i = 0; i < lent_.size(); ++i) {
+        io_uring_buf_ring_add(bufferRing_, buffers_.data() + lent_[i] * URING_BUFFER_SIZE,
+                              URING_BUFFER_SIZE, lent_[i], mask, static_cast<int>(i));
+    }
+    io_uring_buf_ring_advance(bufferRing_, static_cast<int>(lent_.size()));
+    lent_.clear();
+#endif
+}
+
+int UringReceiverTransport::receiveBatch(struct mmsghdr* messages, unsigned int count) {
+#if defined(MULTICAST_HAVE_LIBURING)
+    if (ring_) {
+        recycleBuffers();
+        // Multishot-запрос живёт, пока ядро не снимет его (кончились буферы, ошибка)
+        if (!armed_) {
+            io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+            io_uring_prep_recvmsg_multishot(sqe, 0, &recvTemplate_, 0);
+            sqe->flags |= IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+            sqe->buf_group = URING_BUFFER_GROUP;
+            io_uring_sqe_set_data64(sqe, URING_RECV_TAG);
+            armed_ = true;
+        }
+        if (!wakeArmed_) {
+            io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+            io_uring_prep_poll_add(sqe, wakeFd_, POLLIN);
+            io_uring_sqe_set_data64(sqe, URING_WAKE_TAG);
+            wakeArmed_ = true;
+        }
+
+        // В ядро - только если надо отправить запрос или ждать первую датаграмму
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_sq_ready(ring_) > 0 || io_uring_peek_cqe(ring_, &cqe) != 0) {
+            __kernel_timespec ts;
+            ts.tv_sec = receiveTimeout_.count() / 1000000;
+            ts.tv_nsec = (receiveTimeout_.count() % 1000000) * 1000;
+            int ret = io_uring_submit_and_wait_timeout(ring_, &cqe, 1, &ts, nullptr);
+            syscalls_.store(syscalls_.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            if (ret < 0 && ret != -ETIME) {
+                errno = -ret;
+                return -1;
+            }
+        }
+
+        unsigned int received = 0;
+        int error = 0;
+        sockaddr_in source{};
+        bool hasSource = false;
+        bool woken = false;
+        while (received < count && io_uring_peek_cqe(ring_, &cqe) == 0) {
+            int res = cqe->res;
+            unsigned int flags = cqe->flags;
+            uint64_t tag = cqe->user_data;
+            io_uring_cqe_seen(ring_, cqe);
+            if (tag == URING_WAKE_TAG) {
+                uint64_t value;
+                ssize_t got = read(wakeFd_, &value, sizeof(value));
+                (void)got;
+                wakeArmed_ = false;
+                woken = true;
+                continue;
+            }
+            if (!(flags & IORING_CQE_F_MORE)) armed_ = false;
+            // ENOBUFS - буферы кончились, запрос перевзведётся на следующем вызове
+            if (res < 0 || !(flags & IORING_CQE_F_BUFFER)) {
+                if (res < 0) error = -res;
+                continue;
+            }
+
+            auto id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+            lent_.push_back(id);
+            io_uring_recvmsg_out* out =
+                io_uring_recvmsg_validate(buffers_.data() + id * URING_BUFFER_SIZE, res,
+                                          &recvTemplate_);
+            if (!out) continue;
+
+            msghdr& msg = messages[received].msg_hdr;
+            size_t len = io_uring_recvmsg_payload_length(out, res, &recvTemplate_);
+            msg.msg_flags = out->flags & MSG_TRUNC;
+            if (len > msg.msg_iov[0].iov_len) {
+                len = msg.msg_iov[0].iov_len;
+                msg.msg_flags |= MSG_TRUNC;
+            }
+            // Датаграмма остаётся в буфере кольца, без копирования в буфер Receiver'а
+            msg.msg_iov[0].iov_base = io_uring_recvmsg_payload(out, &recvTemplate_);
+            msg.msg_iov[0].iov_len = len;
+            messages[received].msg_len = static_cast<unsigned int>(len);
+            if (out->namelen >= sizeof(source)) {
+                memcpy(&source, io_uring_recvmsg_name(out), sizeof(source));
+                hasSource = true;
+            }
+            ++received;
+        }
+
+        if (received > 0) {
+            received_ = true;
+            if (hasSource) rememberSource(source);
+            return static_cast<int>(received);
+        }
+        // Ядро без multishot recvmsg (до 6.0) отвергает запрос сразу
+        if (woken) {
+            errno = EINTR;
+            return -1;
+        }
+        if (error == EINVAL && !received_) {
+            MULTICAST_LOG_WARNING("io_uring multishot recvmsg unsupported, using recvmmsg");
+            destroyRing();
+        } else {
+            errno = error ? error : EAGAIN;
+            return -1;
+        }
+    }
+#endif
+    return UdpReceiverTransport::receiveBatch(messages, count);
+}
+
+}  // namespace MulticastLib
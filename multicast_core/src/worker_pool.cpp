@@ -0,0 +1,65 @@
+#include "worker_pool.h"
+
+namespace MulticastLib {
+
+WorkerPool::WorkerPool(int threadCount) {
+    for (int i = 1; i < threadCount; ++i) {
+        workers_.emplace_back(&WorkerPool::workerLoop, this, static_cast<size_t>(i));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    startCondition_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+void WorkerPool::runTasks(size_t worker) {
+    // Задачи разбираются по одной: полосы кодируются разное время
+    for (size_t i = nextTask_.fetch_add(1); i < taskCount_; i = nextTask_.fetch_add(1)) {
+        (*task_)(i, worker);
+    }
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t, size_t)>& task) {
+    if (workers_.empty() || count < 2) {
+        for (size_t i = 0; i < count; ++i) task(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        taskCount_ = count;
+        nextTask_.store(0);
+        activeWorkers_ = workers_.size();
+        generation_++;
+    }
+    startCondition_.notify_all();
+    runTasks(0);
+
+    // task живёт на стеке вызывающего, поэтому ждём, пока его отпустят все исполнители
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCondition_.wait(lock, [this]() { return activeWorkers_ == 0; });
+    task_ = nullptr;
+}
+
+void WorkerPool::workerLoop(size_t worker) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            startCondition_.wait(lock, [&]() { return stopping_ || generation_ != seen; });
+            if (stopping_) return;
+            seen = generation_;
+        }
+        runTasks(worker);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--activeWorkers_ == 0) doneCondition_.notify_one();
+    }
+}
+
+}  // namespace MulticastLib
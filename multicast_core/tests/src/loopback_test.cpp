@@ -0,0 +1,249 @@
+// Sender -> Receiver через LoopbackNetwork, без сети и камеры: доставка кадров при
+// потерях, перестановках и дублях, восстановление одного потерянного чанка по FEC и
+// двух потерянных в одной группе - по NACK. Искажения сети заданы зерном, а чанки для
+// FEC и NACK выбрасываются по номеру, поэтому прогон воспроизводим.
+// Код возврата 0 - все проверки прошли
+#include <multicast_core.h>
+#include <multicast_core_bits/loopback_transport.h>
+#include <multicast_core_bits/protocol.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace MulticastLib;
+
+#define MCAST_GRP "239.0.0.1"
+#define MCAST_PORT 5000
+// Кадров в прогоне и кадр (по порядку отправки), у которого выбрасываются чанки
+#define TEST_FRAMES 20
+#define TARGET_FRAME 3
+// Сколько ждать отправки всех кадров и их декодирования
+#define TEST_TIMEOUT_MS 10000
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                               \
+        }                                                                             \
+    } while (0)
+
+// Транспорт Sender'а поверх LoopbackNetwork, который теряет заданные чанки данных
+// кадра TARGET_FRAME при первой отправке. Перепосылки по NACK и чётность проходят
+class DroppingTransport : public SenderTransport {
+   public:
+    DroppingTransport(std::unique_ptr<SenderTransport> inner, std::set<uint16_t> dropChunks)
+        : inner_(std::move(inner)), dropChunks_(std::move(dropChunks)) {}
+
+    bool open(std::chrono::microseconds controlTimeout) override {
+        return inner_->open(controlTimeout);
+    }
+    void close() override { inner_->close(); }
+
+    int sendBatch(struct mmsghdr* messages, unsigned int count) override {
+        std::vector<mmsghdr> passed;
+        passed.reserve(count);
+        {
+            // sendBatch зовут поток отправки и управляющий поток
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (unsigned int i = 0; i < count; ++i) {
+                messages[i].msg_len = static_cast<unsigned int>(datagramLength(messages[i]));
+                if (!shouldDrop(messages[i])) passed.push_back(messages[i]);
+            }
+        }
+        if (!passed.empty() &&
+            inner_->sendBatch(passed.data(), static_cast<unsigned int>(passed.size())) < 0) {
+            return -1;
+        }
+        return static_cast<int>(count);
+    }
+
+    int receiveControl(struct mmsghdr* messages, unsigned int count) override {
+        return inner_->receiveControl(messages, count);
+    }
+
+    size_t droppedChunks() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+   private:
+    static size_t datagramLength(const mmsghdr& message) {
+        size_t len = 0;
+        for (size_t j = 0; j < message.msg_hdr.msg_iovlen; ++j) {
+            len += message.msg_hdr.msg_iov[j].iov_len;
+        }
+        return len;
+    }
+
+    bool shouldDrop(const mmsghdr& message) {
+        std::vector<uint8_t> datagram;
+        datagram.reserve(message.msg_len);
+        for (size_t j = 0; j < message.msg_hdr.msg_iovlen; ++j) {
+            auto* base = static_cast<const uint8_t*>(message.msg_hdr.msg_iov[j].iov_base);
+            datagram.insert(datagram.end(), base, base + message.msg_hdr.msg_iov[j].iov_len);
+        }
+        ChunkInfo info;
+        if (!parseChunkHeader(datagram.data(), datagram.size(), &info)) return false;
+        // Номера кадров Sender начинает со случайного, отсчёт - от первого отправленного
+        if (!hasFirst_) {
+            hasFirst_ = true;
+            firstFrameSeq_ = info.frameSeq;
+        }
+        if (info.frameSeq - firstFrameSeq_ != TARGET_FRAME) return false;
+        if (info.flags & (CHUNK_FLAG_PARITY | CHUNK_FLAG_RETRANSMIT)) return false;
+        if (!dropChunks_.count(info.chunkIndex)) return false;
+        ++dropped_;
+        return true;
+    }
+
+    std::unique_ptr<SenderTransport> inner_;
+    std::set<uint16_t> dropChunks_;
+    std::mutex mutex_;
+    bool hasFirst_ = false;
+    uint32_t firstFrameSeq_ = 0;
+    size_t dropped_ = 0;
+};
+
+SenderConfig makeSenderConfig() {
+    SenderConfig config;
+    config.source.type = FrameSourceType::Synthetic;
+    config.source.width = 640;
+    config.source.height = 480;
+    config.targetFps = 60.0;
+    // Группы по 4 чанка: чанки 1 и 2 попадают в одну группу
+    config.fecGroupSize = 4;
+    return config;
+}
+
+struct RunResult {
+    SenderStatistics sender;
+    ReceiverStatistics receiver;
+};
+
+// Отправляет TEST_FRAMES кадров и ждёт, пока приёмник разберётся со всеми
+RunResult runStream(Sender& sender, Receiver& receiver) {
+    RunResult result;
+    CHECK(receiver.start());
+    CHECK(sender.startStream());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TEST_TIMEOUT_MS);
+    while (sender.getStatistics().totalFramesSent < TEST_FRAMES &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    sender.stopStream();
+    result.sender = sender.getStatistics();
+
+    // Кадр считается разобранным, если он декодирован или опоздал к более новому
+    while (std::chrono::steady_clock::now() < deadline) {
+        result.receiver = receiver.getStatistics();
+        if (result.receiver.totalFramesDecoded + result.receiver.totalStaleFrames +
+                result.receiver.totalFramesDropped >=
+            result.sender.totalFramesSent) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    receiver.stop();
+    result.receiver = receiver.getStatistics();
+    return result;
+}
+
+// Потери, перестановки и дубли с фиксированным зерном: кадры доходят за счёт FEC и NACK
+void testDeliveryUnderDistortion() {
+    LoopbackConfig networkConfig;
+    networkConfig.lossRatio = 0.02;
+    networkConfig.duplicateRatio = 0.05;
+    networkConfig.reorderRatio = 0.1;
+    networkConfig.seed = 42;
+    auto network = std::make_shared<LoopbackNetwork>(networkConfig);
+
+    Sender sender(MCAST_GRP, MCAST_PORT, makeSenderConfig());
+    CHECK(sender.setTransport(network->createSenderTransport()));
+    Receiver receiver(MCAST_GRP, MCAST_PORT);
+    CHECK(receiver.setTransport(network->createReceiverTransport()));
+
+    RunResult result = runStream(sender, receiver);
+    LoopbackStatistics networkStats = network->getStatistics();
+
+    CHECK(result.sender.totalFramesSent >= TEST_FRAMES);
+    CHECK(networkStats.packetsLost > 0);
+    CHECK(networkStats.packetsDuplicated > 0);
+    // Дубли и опоздавшие пакеты не должны мешать сборке: доходит не меньше 90% кадров
+    CHECK(result.receiver.totalFramesDecoded * 10 >= result.sender.totalFramesSent * 9);
+    CHECK(result.receiver.totalRecoveredChunks + result.sender.totalRetransmittedPackets > 0);
+}
+
+// Один потерянный чанк группы восстанавливается по чётности, без NACK
+void testFecRecoversSingleLoss() {
+    auto network = std::make_shared<LoopbackNetwork>();
+    Sender sender(MCAST_GRP, MCAST_PORT, makeSenderConfig());
+    auto transport = std::make_unique<DroppingTransport>(network->createSenderTransport(),
+                                                         std::set<uint16_t>{1});
+    DroppingTransport* dropping = transport.get();
+    CHECK(sender.setTransport(std::move(transport)));
+
+    ReceiverConfig receiverConfig;
+    receiverConfig.enableNack = false;
+    Receiver receiver(MCAST_GRP, MCAST_PORT, receiverConfig);
+    CHECK(receiver.setTransport(network->createReceiverTransport()));
+
+    RunResult result = runStream(sender, receiver);
+
+    CHECK(dropping->droppedChunks() == 1);
+    CHECK(result.receiver.totalRecoveredChunks == 1);
+    CHECK(result.receiver.totalNacksSent == 0);
+    CHECK(result.receiver.totalFramesDropped == 0);
+    CHECK(result.receiver.totalFramesDecoded + result.receiver.totalStaleFrames ==
+          result.sender.totalFramesSent);
+}
+
+// Два потерянных чанка одной группы FEC не восстановит - их перепосылает Sender по NACK
+void testNackRepairsDoubleLoss() {
+    auto network = std::make_shared<LoopbackNetwork>();
+    Sender sender(MCAST_GRP, MCAST_PORT, makeSenderConfig());
+    auto transport = std::make_unique<DroppingTransport>(network->createSenderTransport(),
+                                                         std::set<uint16_t>{1, 2});
+    DroppingTransport* dropping = transport.get();
+    CHECK(sender.setTransport(std::move(transport)));
+
+    Receiver receiver(MCAST_GRP, MCAST_PORT);
+    CHECK(receiver.setTransport(network->createReceiverTransport()));
+
+    RunResult result = runStream(sender, receiver);
+
+    CHECK(dropping->droppedChunks() == 2);
+    CHECK(result.receiver.totalRecoveredChunks == 0);
+    CHECK(result.receiver.totalNacksSent > 0);
+    CHECK(result.sender.totalRetransmittedPackets >= 2);
+    CHECK(result.receiver.totalFramesDropped == 0);
+    CHECK(result.receiver.totalFramesDecoded + result.receiver.totalStaleFrames ==
+          result.sender.totalFramesSent);
+}
+
+}  // namespace
+
+int main() {
+    testDeliveryUnderDistortion();
+    testFecRecoversSingleLoss();
+    testNackRepairsDoubleLoss();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("loopback_test: OK\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+// RateController без Sender'а и сети: спуск по ступеням при потерях и превышении цели,
+// подъём при запасе и возврат к максимуму при выключении адаптации.
+// Код возврата 0 - все проверки прошли
+#include <multicast_core_bits/rate_controller.h>
+
+#include <cstdio>
+
+using namespace MulticastLib;
+
+#define MAX_QUALITY 80
+#define MAX_FPS 30.0
+#define TARGET_KBPS 4000
+#define LOSS_THRESHOLD 0.05
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                               \
+        }                                                                             \
+    } while (0)
+
+bool atMaximum(const OperatingPoint& point) {
+    return point.jpegQuality == MAX_QUALITY && point.scale == 1.0 && point.fps == MAX_FPS;
+}
+
+// Сильные потери спускают точку через качество и разрешение до частоты кадров
+void testStepsDownOnLoss() {
+    RateController controller(TARGET_KBPS, LOSS_THRESHOLD, MAX_QUALITY, MAX_FPS);
+    CHECK(atMaximum(controller.current()));
+
+    for (int i = 0; i < 20; ++i) controller.update(TARGET_KBPS, 0.5);
+    const OperatingPoint& point = controller.current();
+    CHECK(point.jpegQuality < MAX_QUALITY);
+    CHECK(point.scale < 1.0);
+    CHECK(point.fps < MAX_FPS);
+}
+
+// При запасе по битрейту и без потерь точка возвращается к максимуму
+void testStepsUpWithHeadroom() {
+    RateController controller(TARGET_KBPS, LOSS_THRESHOLD, MAX_QUALITY, MAX_FPS);
+    for (int i = 0; i < 20; ++i) controller.update(TARGET_KBPS * 2, 0.0);
+    CHECK(!atMaximum(controller.current()));
+
+    for (int i = 0; i < 100; ++i) controller.update(TARGET_KBPS / 2, 0.0);
+    CHECK(atMaximum(controller.current()));
+}
+
+// Выключение адаптации возвращает точку к максимуму, и она там остаётся
+void testDisableRestoresMaximum() {
+    RateController controller(TARGET_KBPS, LOSS_THRESHOLD, MAX_QUALITY, MAX_FPS);
+    for (int i = 0; i < 20; ++i) controller.update(TARGET_KBPS, 0.5);
+    CHECK(!atMaximum(controller.current()));
+
+    controller.setTargetBitrate(0);
+    CHECK(!controller.enabled());
+    CHECK(atMaximum(controller.current()));
+
+    controller.update(TARGET_KBPS * 10, 0.5);
+    CHECK(atMaximum(controller.current()));
+
+    // Снова включённая адаптация начинает с максимума, а не со старой ступени
+    controller.setTargetBitrate(TARGET_KBPS);
+    controller.update(TARGET_KBPS * 2, 0.0);
+    CHECK(controller.current().jpegQuality == MAX_QUALITY - 5);
+    CHECK(controller.current().scale == 1.0);
+}
+
+}  // namespace
+
+int main() {
+    testStepsDownOnLoss();
+    testStepsUpWithHeadroom();
+    testDisableRestoresMaximum();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("rate_controller_test: OK\n");
+    return 0;
+}
@@ -6,18 +6,40 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "video_frame.h"
+
 namespace py = pybind11;
 
-inline py::object matToNumpy(const cv::Mat& mat) {
-    if (mat.empty()) return py::none();
+// Массив без копии поверх буфера кадра: capsule держит ссылку на кадр, пока жив массив
+// (и его срезы). Кадр неизменяем, поэтому массив только для чтения
+inline py::object frameToNumpy(MulticastLib::FrameHandle frame) {
+    if (!frame || frame->image.empty()) return py::none();
+
+    const cv::Mat& mat = frame->image;
+    auto* owner = new MulticastLib::FrameHandle(std::move(frame));
+    py::capsule base(owner, [](void* p) { delete static_cast<MulticastLib::FrameHandle*>(p); });
+
+    py::array_t<unsigned char> array(
+        {mat.rows, mat.cols, mat.channels()},
+        {static_cast<py::ssize_t>(mat.step[0]), static_cast<py::ssize_t>(mat.elemSize()),
+         static_cast<py::ssize_t>(sizeof(unsigned char))},
+        mat.data, base);
+    array.attr("setflags")(py::arg("write") = false);
+    return std::move(array);
+}
+
+// Принятый JPEG как одномерный массив байтов, тоже без копии и только для чтения
+inline py::object encodedFrameToNumpy(MulticastLib::EncodedFrameHandle frame) {
+    if (!frame || frame->jpeg.empty()) return py::none();
 
-    py::buffer_info buffer_info(mat.data, sizeof(unsigned char),
-                                py::format_descriptor<unsigned char>::format(), 3,
-                                {mat.rows, mat.cols, mat.channels()},
-                                {sizeof(unsigned char) * mat.cols * mat.channels(),
-                                 sizeof(unsigned char) * mat.channels(), sizeof(unsigned char)});
+    const std::vector<uint8_t>& jpeg = frame->jpeg;
+    auto* owner = new MulticastLib::EncodedFrameHandle(std::move(frame));
+    py::capsule base(owner,
+                     [](void* p) { delete static_cast<MulticastLib::EncodedFrameHandle*>(p); });
 
-    return py::array_t<unsigned char>(buffer_info);
+    py::array_t<uint8_t> array(static_cast<py::ssize_t>(jpeg.size()), jpeg.data(), base);
+    array.attr("setflags")(py::arg("write") = false);
+    return std::move(array);
 }
 
 #endif  // CONVERTERS_H
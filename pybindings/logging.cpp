@@ -0,0 +1,86 @@
+#include "logging.h"
+
+#include <pybind11/pybind11.h>
+
+#include <algorithm>
+
+namespace py = pybind11;
+using namespace MulticastLib;
+
+namespace {
+
+// Приёмник зовётся фоновым потоком журнала и берёт GIL на каждую запись; потоки
+// приёма и отправки GIL не касаются
+void setPythonSink(py::function handler) {
+    // Ссылку на обработчик отпускаем под GIL, в каком бы потоке ни умер приёмник
+    std::shared_ptr<py::function> function(new py::function(std::move(handler)),
+                                           [](py::function* f) {
+                                               py::gil_scoped_acquire gil;
+                                               delete f;
+                                           });
+    py::gil_scoped_release release;
+    setLogSink([function](const LogRecord& record) {
+        py::gil_scoped_acquire gil;
+        try {
+            (*function)(record.level, record.timestampUs, record.threadId, record.message);
+        } catch (py::error_already_set& e) {
+            e.discard_as_unraisable("multicast_core log handler");
+        }
+    });
+}
+
+void resetSink() {
+    // Фоновый поток может ждать GIL внутри приёмника, держа его мьютекс
+    py::gil_scoped_release release;
+    setLogSink(nullptr);
+}
+
+}  // namespace
+
+void init_logging(py::module_& m) {
+    py::enum_<LogLevel>(m, "LogLevel")
+        .value("Trace", LogLevel::Trace)
+        .value("Debug", LogLevel::Debug)
+        .value("Info", LogLevel::Info)
+        .value("Warning", LogLevel::Warning)
+        .value("Error", LogLevel::Error)
+        .value("Off", LogLevel::Off);
+
+    m.def("set_log_level", &setLogLevel, py::arg("level"),
+          "Set the lowest level written by the C++ core");
+    m.def("get_log_level", &getLogLevel);
+    m.def("set_log_rate_limit", &setLogRateLimit, py::arg("records_per_second"),
+          "Limit records per second from one call site, 0 disables the limit");
+    m.def("dropped_log_records", &droppedLogRecords,
+          "Get the number of records lost because a thread log buffer was full");
+    m.def("flush_log", &flushLog, py::call_guard<py::gil_scoped_release>(),
+          "Write out everything logged so far");
+    m.def("set_log_handler", &setPythonSink, py::arg("handler"),
+          "Route records to handler(level, timestamp_us, thread_id, message) "
+          "called from the logging thread");
+    m.def("reset_log_handler", &resetSink, "Write records to stderr again");
+    m.def(
+        "use_python_logging",
+        [](const std::string& name) {
+            // Уровни журнала переводятся в уровни logging; Trace ниже DEBUG
+            py::object logger = py::module_::import("logging").attr("getLogger")(name);
+            setPythonSink(py::cpp_function([logger](LogLevel level, int64_t timestampUs,
+                                                    uint32_t threadId, const char* message) {
+                static const int levels[] = {5, 10, 20, 30, 40};
+                int pyLevel = levels[std::min(static_cast<int>(level), 4)];
+                py::dict extra;
+                extra["multicast_timestamp_us"] = timestampUs;
+                extra["multicast_thread_id"] = threadId;
+                logger.attr("log")(pyLevel, "%s", message, py::arg("extra") = extra);
+            }));
+        },
+        py::arg("name") = "multicast_core",
+        "Route records to the Python logger with the given name");
+    m.def("start_trace", &startTrace, py::arg("path"), py::call_guard<py::gil_scoped_release>(),
+          "Write capture/encode/send/reassemble/decode spans to a Chrome trace JSON file");
+    m.def("stop_trace", &stopTrace, py::call_guard<py::gil_scoped_release>(),
+          "Finish the trace file");
+
+    // Приёмник на Python нельзя вызывать после остановки интерпретатора
+    py::module_::import("atexit").attr("register")(py::cpp_function(&resetSink));
+}
@@ -0,0 +1,35 @@
+#include "loopback_transport.h"
+
+#include <pybind11/pybind11.h>
+
+namespace py = pybind11;
+using namespace MulticastLib;
+
+void init_loopback(py::module_& m) {
+    py::class_<LoopbackConfig>(m, "LoopbackConfig")
+        .def(py::init<>())
+        .def_readwrite("mtu", &LoopbackConfig::mtu)
+        .def_readwrite("capacity", &LoopbackConfig::capacity)
+        .def_readwrite("lossRatio", &LoopbackConfig::lossRatio)
+        .def_readwrite("duplicateRatio", &LoopbackConfig::duplicateRatio)
+        .def_readwrite("reorderRatio", &LoopbackConfig::reorderRatio)
+        .def_readwrite("reorderDelayUs", &LoopbackConfig::reorderDelayUs)
+        .def_readwrite("delayUs", &LoopbackConfig::delayUs)
+        .def_readwrite("jitterUs", &LoopbackConfig::jitterUs)
+        .def_readwrite("seed", &LoopbackConfig::seed);
+
+    py::class_<LoopbackStatistics>(m, "LoopbackStatistics")
+        .def_readonly("packetsSent", &LoopbackStatistics::packetsSent)
+        .def_readonly("packetsDelivered", &LoopbackStatistics::packetsDelivered)
+        .def_readonly("packetsLost", &LoopbackStatistics::packetsLost)
+        .def_readonly("packetsOverflowed", &LoopbackStatistics::packetsOverflowed)
+        .def_readonly("packetsOversized", &LoopbackStatistics::packetsOversized)
+        .def_readonly("packetsDuplicated", &LoopbackStatistics::packetsDuplicated)
+        .def_readonly("controlMessages", &LoopbackStatistics::controlMessages);
+
+    py::class_<LoopbackNetwork, std::shared_ptr<LoopbackNetwork>>(m, "LoopbackNetwork")
+        .def(py::init<>())
+        .def(py::init<const LoopbackConfig&>())
+        .def("get_statistics", &LoopbackNetwork::getStatistics,
+             "Get delivery and impairment counters of the in-process network");
+}
@@ -2,15 +2,37 @@
 
 namespace py = pybind11;
 
+void init_io_backend(py::module &);
 void init_receiver(py::module &);
+void init_receiver_config(py::module &);
 void init_sender(py::module &);
+void init_frame_source_config(py::module &);
+void init_sender_config(py::module &);
+void init_pipeline_statistics(py::module &);
 void init_receiver_statistics(py::module &);
+void init_transmit_statistics(py::module &);
+void init_operating_point(py::module &);
+void init_latency_summary(py::module &);
+void init_sender_statistics(py::module &);
+void init_logging(py::module &);
+void init_loopback(py::module &);
 
 PYBIND11_MODULE(multicast_core, m) {
     // Optional docstring
     m.doc() = "multicast_core library";
 
+    init_io_backend(m);
+    init_latency_summary(m);
+    init_receiver_config(m);
     init_receiver(m);
     init_receiver_statistics(m);
+    init_frame_source_config(m);
+    init_sender_config(m);
     init_sender(m);
+    init_pipeline_statistics(m);
+    init_transmit_statistics(m);
+    init_sender_statistics(m);
+    init_operating_point(m);
+    init_logging(m);
+    init_loopback(m);
 }
@@ -5,26 +5,232 @@
 #include <pybind11/stl.h>
 
 #include "converters.h"
+#include "loopback_transport.h"
 
 namespace py = pybind11;
 using namespace MulticastLib;
 
+namespace {
+
+// Деструктор останавливает приём и ждёт поток обработчиков кадров, которому может
+// понадобиться GIL, поэтому Receiver удаляется с отпущенным GIL
+struct ReceiverDeleter {
+    void operator()(Receiver* receiver) const {
+        py::gil_scoped_release release;
+        delete receiver;
+    }
+};
+
+// Кадр для Python: (массив, номер кадра, время захвата в мкс по часам Sender'а)
+py::object frameToTuple(FrameHandle frame) {
+    const uint64_t sequence = frame->sequence;
+    const uint64_t captureTimestampUs = frame->captureTimestampUs;
+    return py::make_tuple(frameToNumpy(std::move(frame)), sequence, captureTimestampUs);
+}
+
+py::object frameToTuple(EncodedFrameHandle frame) {
+    const uint64_t sequence = frame->sequence;
+    const uint64_t captureTimestampUs = frame->captureTimestampUs;
+    return py::make_tuple(encodedFrameToNumpy(std::move(frame)), sequence, captureTimestampUs);
+}
+
+size_t addPythonFrameCallback(Receiver& self, py::function callback) {
+    // Обработчик может уничтожиться в любом потоке - ссылку на функцию отпускаем под GIL
+    std::shared_ptr<py::function> function(new py::function(std::move(callback)),
+                                           [](py::function* f) {
+                                               py::gil_scoped_acquire gil;
+                                               delete f;
+                                           });
+    FrameCallback wrapper = [function](const FrameHandle& frame) {
+        py::gil_scoped_acquire gil;
+        try {
+            (*function)(frameToNumpy(frame), frame->sequence, frame->captureTimestampUs);
+        } catch (py::error_already_set& e) {
+            e.discard_as_unraisable("Receiver frame callback");
+        }
+    };
+    // Регистрация берёт мьютекс обработчиков - без GIL, как и remove_frame_callback
+    py::gil_scoped_release release;
+    return self.addFrameCallback(std::move(wrapper));
+}
+
+// Асинхронный итератор кадров: каждый новый кадр отдаётся один раз, кадры, пришедшие
+// пока потребитель занят, пропускаются. Ожидание идёт в пуле потоков event loop'а с
+// отпущенным GIL, сам loop не блокируется. Итерация заканчивается с остановкой приёма
+struct FrameStream {
+    Receiver* receiver;
+    std::chrono::milliseconds pollInterval;
+    uint64_t lastSequence = 0;
+
+    py::object next() {
+        FrameHandle frame;
+        {
+            py::gil_scoped_release release;
+            while (!frame && receiver->isReceiving()) {
+                frame = receiver->waitForFrame(lastSequence, pollInterval);
+            }
+        }
+        if (!frame) {
+            PyErr_SetNone(PyExc_StopAsyncIteration);
+            throw py::error_already_set();
+        }
+        lastSequence = frame->sequence;
+        return frameToTuple(std::move(frame));
+    }
+};
+
+}  // namespace
+
 void init_receiver(py::module_& m) {
-    py::class_<Receiver>(m, "Receiver")
+    py::class_<FrameStream>(m, "FrameStream")
+        .def("__aiter__", [](py::object self) { return self; })
+        .def("__anext__",
+             [](py::object self) {
+                 py::object loop = py::module_::import("asyncio").attr("get_running_loop")();
+                 return loop.attr("run_in_executor")(py::none(), self.attr("next"));
+             })
+        .def("next", &FrameStream::next,
+             "Block until the next new frame, raise StopAsyncIteration when stopped");
+
+    py::class_<Receiver, std::unique_ptr<Receiver, ReceiverDeleter>>(m, "Receiver")
         .def(py::init<const std::string&, int>())
-        .def("start", &Receiver::start)
-        .def("stop", &Receiver::stop)
+        .def(py::init<const std::string&, int, const ReceiverConfig&>())
+        .def("start", &Receiver::start, py::call_guard<py::gil_scoped_release>())
+        .def("stop", &Receiver::stop, py::call_guard<py::gil_scoped_release>())
         .def("is_active", &Receiver::isReceiving)
         .def(
-            "get_latest_frame", [](Receiver& self) { return matToNumpy(self.getLatestFrame()); },
-            "Get latest frame as numpy array")
+            "get_latest_frame",
+            [](Receiver& self) {
+                FrameHandle frame;
+                {
+                    py::gil_scoped_release release;
+                    frame = self.getLatestFrameHandle();
+                }
+                return frameToNumpy(std::move(frame));
+            },
+            "Get latest frame as read-only numpy array sharing the decoded buffer")
+        .def(
+            "wait_for_frame",
+            [](Receiver& self, uint64_t lastSequence, int timeoutMs) -> py::object {
+                FrameHandle frame;
+                {
+                    py::gil_scoped_release release;
+                    frame = self.waitForFrame(lastSequence, std::chrono::milliseconds(timeoutMs));
+                }
+                if (!frame) return py::none();
+                return frameToTuple(std::move(frame));
+            },
+            py::arg("last_sequence") = 0, py::arg("timeout_ms") = 1000,
+            "Wait for a frame newer than last_sequence, return (frame, sequence, "
+            "capture_timestamp_us) or None on timeout")
+        .def(
+            "get_latest_encoded_frame",
+            [](Receiver& self) -> py::object {
+                EncodedFrameHandle frame;
+                {
+                    py::gil_scoped_release release;
+                    frame = self.getLatestEncodedFrame();
+                }
+                if (!frame) return py::none();
+                return frameToTuple(std::move(frame));
+            },
+            "Get latest received JPEG as (read-only uint8 array, sequence, "
+            "capture_timestamp_us) or None")
+        .def(
+            "wait_for_encoded_frame",
+            [](Receiver& self, uint64_t lastSequence, int timeoutMs) -> py::object {
+                EncodedFrameHandle frame;
+                {
+                    py::gil_scoped_release release;
+                    frame = self.waitForEncodedFrame(lastSequence,
+                                                     std::chrono::milliseconds(timeoutMs));
+                }
+                if (!frame) return py::none();
+                return frameToTuple(std::move(frame));
+            },
+            py::arg("last_sequence") = 0, py::arg("timeout_ms") = 1000,
+            "Wait for a received JPEG newer than last_sequence, return (jpeg, sequence, "
+            "capture_timestamp_us) or None on timeout")
+        .def("set_decode_enabled", &Receiver::setDecodeEnabled, py::arg("enabled"),
+             "Enable or disable decoding of whole frames, JPEG passthrough keeps working")
+        .def("add_frame_callback", &addPythonFrameCallback, py::arg("callback"),
+             "Call callback(frame, sequence, capture_timestamp_us) for every new frame from "
+             "a background thread, return id for remove_frame_callback")
+        .def("remove_frame_callback", &Receiver::removeFrameCallback, py::arg("id"),
+             py::call_guard<py::gil_scoped_release>())
+        .def(
+            "frames",
+            [](Receiver& self, int pollIntervalMs) {
+                return FrameStream{&self, std::chrono::milliseconds(pollIntervalMs)};
+            },
+            py::arg("poll_interval_ms") = 100, py::keep_alive<0, 1>(),
+            "Async iterator over new frames: async for frame, sequence, timestamp_us in ...")
+        .def(
+            "use_loopback",
+            [](Receiver& self, std::shared_ptr<LoopbackNetwork> network) {
+                return self.setTransport(network->createReceiverTransport());
+            },
+            py::arg("network"), "Receive from an in-process LoopbackNetwork instead of UDP")
         .def("getStatistics", &Receiver::getStatistics);
 }
 
+void init_receiver_config(py::module_& m) {
+    py::class_<ReceiverConfig>(m, "ReceiverConfig")
+        .def(py::init<>())
+        .def_readwrite("recvBatchSize", &ReceiverConfig::recvBatchSize)
+        .def_readwrite("packetSlotSize", &ReceiverConfig::packetSlotSize)
+        .def_readwrite("socketRecvBufferSize", &ReceiverConfig::socketRecvBufferSize)
+        .def_readwrite("ioBackend", &ReceiverConfig::ioBackend)
+        .def_readwrite("receiveOffload", &ReceiverConfig::receiveOffload)
+        .def_readwrite("frameSlotCount", &ReceiverConfig::frameSlotCount)
+        .def_readwrite("maxFrameSize", &ReceiverConfig::maxFrameSize)
+        .def_readwrite("decodeThreads", &ReceiverConfig::decodeThreads)
+        .def_readwrite("decodeQueueCapacity", &ReceiverConfig::decodeQueueCapacity)
+        .def_readwrite("segmentDecodeThreads", &ReceiverConfig::segmentDecodeThreads)
+        .def_readwrite("heartbeatIntervalMs", &ReceiverConfig::heartbeatIntervalMs)
+        .def_readwrite("enableNack", &ReceiverConfig::enableNack)
+        .def_readwrite("nackDelayMs", &ReceiverConfig::nackDelayMs)
+        .def_readwrite("nackRetryMs", &ReceiverConfig::nackRetryMs)
+        .def_readwrite("maxNackRetries", &ReceiverConfig::maxNackRetries)
+        .def_readwrite("decodePartialFrames", &ReceiverConfig::decodePartialFrames)
+        .def_readwrite("partialFrameDelayMs", &ReceiverConfig::partialFrameDelayMs)
+        .def_readwrite("decodeToYuv", &ReceiverConfig::decodeToYuv)
+        .def_readwrite("decodeFrames", &ReceiverConfig::decodeFrames);
+}
+
 void init_receiver_statistics(py::module_& m) {
     py::class_<ReceiverStatistics>(m, "ReceiverStatistics")
     .def_readonly("totalPacketsReceived", &ReceiverStatistics::totalPacketsReceived)
+    .def_readonly("totalReceiveSyscalls", &ReceiverStatistics::totalReceiveSyscalls)
     .def_readonly("totalCorruptedPackets", &ReceiverStatistics::totalCorruptedPackets)
     .def_readonly("totalFramesDecoded", &ReceiverStatistics::totalFramesDecoded)
-    .def_readonly("avgFps", &ReceiverStatistics::avgFps);
+    .def_readonly("totalFramesPassedThrough", &ReceiverStatistics::totalFramesPassedThrough)
+    .def_readonly("totalFramesDropped", &ReceiverStatistics::totalFramesDropped)
+    .def_readonly("totalStaleFrames", &ReceiverStatistics::totalStaleFrames)
+    .def_readonly("totalRecoveredChunks", &ReceiverStatistics::totalRecoveredChunks)
+    .def_readonly("totalNacksSent", &ReceiverStatistics::totalNacksSent)
+    .def_readonly("totalPartialFrames", &ReceiverStatistics::totalPartialFrames)
+    .def_readonly("lastFrameCompleteness", &ReceiverStatistics::lastFrameCompleteness)
+    .def_readonly("avgFrameCompleteness", &ReceiverStatistics::avgFrameCompleteness)
+    .def_readonly("avgFps", &ReceiverStatistics::avgFps)
+    .def_readonly("windowFps", &ReceiverStatistics::windowFps)
+    .def_readonly("jitterMs", &ReceiverStatistics::jitterMs)
+    .def_readonly("decodeQueueDepth", &ReceiverStatistics::decodeQueueDepth)
+    .def_readonly("lastDecodeTimeMs", &ReceiverStatistics::lastDecodeTimeMs)
+    .def_readonly("avgDecodeTimeMs", &ReceiverStatistics::avgDecodeTimeMs)
+    .def_readonly("captureToEncodeLatency", &ReceiverStatistics::captureToEncodeLatency)
+    .def_readonly("captureToSendLatency", &ReceiverStatistics::captureToSendLatency)
+    .def_readonly("reassemblyLatency", &ReceiverStatistics::reassemblyLatency)
+    .def_readonly("decodeLatency", &ReceiverStatistics::decodeLatency)
+    .def_readonly("pickupLatency", &ReceiverStatistics::pickupLatency);
+}
+
+void init_latency_summary(py::module_& m) {
+    py::class_<LatencySummary>(m, "LatencySummary")
+    .def_readonly("count", &LatencySummary::count)
+    .def_readonly("meanMs", &LatencySummary::meanMs)
+    .def_readonly("p50Ms", &LatencySummary::p50Ms)
+    .def_readonly("p99Ms", &LatencySummary::p99Ms)
+    .def_readonly("p999Ms", &LatencySummary::p999Ms)
+    .def_readonly("maxMs", &LatencySummary::maxMs);
 }
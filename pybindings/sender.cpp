@@ -5,6 +5,7 @@
 #include <pybind11/stl.h>
 
 #include "converters.h"
+#include "loopback_transport.h"
 
 namespace py = pybind11;
 using namespace MulticastLib;
@@ -12,11 +13,145 @@ using namespace MulticastLib;
 void init_sender(py::module_& m) {
     py::class_<Sender>(m, "Sender")
         .def(py::init<const std::string&, int>())
+        .def(py::init<const std::string&, int, const SenderConfig&>())
         .def("start_stream", &Sender::startStream)
         .def("stop_stream", &Sender::stopStream)
         .def(
-            "get_preview_frame", [](Sender& self) { return matToNumpy(self.getPreviewFrame()); },
-            "Get last captured frame as numpy array")
+            "get_preview_frame",
+            [](Sender& self) {
+                FrameHandle frame;
+                {
+                    py::gil_scoped_release release;
+                    frame = self.getPreviewFrameHandle();
+                }
+                return frameToNumpy(std::move(frame));
+            },
+            "Get last captured frame as read-only numpy array sharing the capture buffer")
         .def("get_active_client_count", &Sender::getActiveClientCount,
-             "Get the number of active clients");
+             "Get the number of active clients")
+        .def("get_transmit_statistics", &Sender::getTransmitStatistics,
+             "Get syscall/packet/byte counters of the transmit path")
+        .def("get_pipeline_statistics", &Sender::getPipelineStatistics,
+             "Get capture/encode queue depths and dropped frame count")
+        .def("get_statistics", &Sender::getStatistics,
+             "Get counters and stage timings of the whole sender pipeline")
+        .def("get_operating_point", &Sender::getOperatingPoint,
+             "Get current JPEG quality, scale and fps chosen by the rate controller")
+        .def("set_target_bitrate", &Sender::setTargetBitrate, py::arg("kbps"),
+             "Set target bitrate in kbit/s, 0 disables adaptation")
+        .def(
+            "use_loopback",
+            [](Sender& self, std::shared_ptr<LoopbackNetwork> network) {
+                return self.setTransport(network->createSenderTransport());
+            },
+            py::arg("network"), "Send into an in-process LoopbackNetwork instead of UDP");
+}
+
+void init_frame_source_config(py::module_& m) {
+    py::enum_<FrameSourceType>(m, "FrameSourceType")
+        .value("Camera", FrameSourceType::Camera)
+        .value("VideoFile", FrameSourceType::VideoFile)
+        .value("RawFile", FrameSourceType::RawFile)
+        .value("Synthetic", FrameSourceType::Synthetic);
+
+    py::class_<FrameSourceConfig>(m, "FrameSourceConfig")
+        .def(py::init<>())
+        .def_readwrite("type", &FrameSourceConfig::type)
+        .def_readwrite("cameraIndex", &FrameSourceConfig::cameraIndex)
+        .def_readwrite("path", &FrameSourceConfig::path)
+        .def_readwrite("loop", &FrameSourceConfig::loop)
+        .def_readwrite("width", &FrameSourceConfig::width)
+        .def_readwrite("height", &FrameSourceConfig::height)
+        .def_readwrite("motion", &FrameSourceConfig::motion);
+}
+
+void init_sender_config(py::module_& m) {
+    py::class_<SenderConfig>(m, "SenderConfig")
+        .def(py::init<>())
+        .def_readwrite("source", &SenderConfig::source)
+        .def_readwrite("targetFps", &SenderConfig::targetFps)
+        .def_readwrite("queueCapacity", &SenderConfig::queueCapacity)
+        .def_readwrite("dropOldest", &SenderConfig::dropOldest)
+        .def_readwrite("mtu", &SenderConfig::mtu)
+        .def_readwrite("ioBackend", &SenderConfig::ioBackend)
+        .def_readwrite("segmentationOffload", &SenderConfig::segmentationOffload)
+        .def_readwrite("fecGroupSize", &SenderConfig::fecGroupSize)
+        .def_readwrite("retransmitFrames", &SenderConfig::retransmitFrames)
+        .def_readwrite("nackSuppressionMs", &SenderConfig::nackSuppressionMs)
+        .def_readwrite("jpegQuality", &SenderConfig::jpegQuality)
+        .def_readwrite("targetBitrateKbps", &SenderConfig::targetBitrateKbps)
+        .def_readwrite("maxLossRatio", &SenderConfig::maxLossRatio)
+        .def_readwrite("tileSize", &SenderConfig::tileSize)
+        .def_readwrite("tileChangeThreshold", &SenderConfig::tileChangeThreshold)
+        .def_readwrite("tileRefreshInterval", &SenderConfig::tileRefreshInterval)
+        .def_readwrite("stripCount", &SenderConfig::stripCount)
+        .def_readwrite("stripThreads", &SenderConfig::stripThreads)
+        .def_readwrite("alignStripsToChunks", &SenderConfig::alignStripsToChunks);
+}
+
+void init_operating_point(py::module_& m) {
+    py::class_<OperatingPoint>(m, "OperatingPoint")
+        .def_readonly("jpegQuality", &OperatingPoint::jpegQuality)
+        .def_readonly("scale", &OperatingPoint::scale)
+        .def_readonly("fps", &OperatingPoint::fps)
+        .def_readonly("targetBitrateKbps", &OperatingPoint::targetBitrateKbps)
+        .def_readonly("measuredBitrateKbps", &OperatingPoint::measuredBitrateKbps)
+        .def_readonly("worstLossRatio", &OperatingPoint::worstLossRatio);
+}
+
+void init_pipeline_statistics(py::module_& m) {
+    py::class_<PipelineStatistics>(m, "PipelineStatistics")
+        .def_readonly("captureQueueDepth", &PipelineStatistics::captureQueueDepth)
+        .def_readonly("encodeQueueDepth", &PipelineStatistics::encodeQueueDepth)
+        .def_readonly("totalFramesCaptured", &PipelineStatistics::totalFramesCaptured)
+        .def_readonly("totalFramesDropped", &PipelineStatistics::totalFramesDropped)
+        .def_readonly("totalTilesSent", &PipelineStatistics::totalTilesSent)
+        .def_readonly("totalTilesSkipped", &PipelineStatistics::totalTilesSkipped);
+}
+
+void init_transmit_statistics(py::module_& m) {
+    py::class_<TransmitStatistics>(m, "TransmitStatistics")
+        .def_readonly("totalFramesSent", &TransmitStatistics::totalFramesSent)
+        .def_readonly("totalPacketsSent", &TransmitStatistics::totalPacketsSent)
+        .def_readonly("totalBytesSent", &TransmitStatistics::totalBytesSent)
+        .def_readonly("totalSyscalls", &TransmitStatistics::totalSyscalls)
+        .def_readonly("totalSendErrors", &TransmitStatistics::totalSendErrors)
+        .def_readonly("totalNacksReceived", &TransmitStatistics::totalNacksReceived)
+        .def_readonly("totalRetransmittedPackets", &TransmitStatistics::totalRetransmittedPackets)
+        .def_readonly("totalSuppressedRetransmits",
+                      &TransmitStatistics::totalSuppressedRetransmits);
+}
+
+void init_sender_statistics(py::module_& m) {
+    py::class_<SenderStatistics>(m, "SenderStatistics")
+        .def_readonly("totalFramesCaptured", &SenderStatistics::totalFramesCaptured)
+        .def_readonly("totalCaptureFailures", &SenderStatistics::totalCaptureFailures)
+        .def_readonly("totalCaptureStalls", &SenderStatistics::totalCaptureStalls)
+        .def_readonly("totalFramesDropped", &SenderStatistics::totalFramesDropped)
+        .def_readonly("totalFramesEncoded", &SenderStatistics::totalFramesEncoded)
+        .def_readonly("totalEncodeFailures", &SenderStatistics::totalEncodeFailures)
+        .def_readonly("totalFramesSent", &SenderStatistics::totalFramesSent)
+        .def_readonly("totalPacketsSent", &SenderStatistics::totalPacketsSent)
+        .def_readonly("totalBytesSent", &SenderStatistics::totalBytesSent)
+        .def_readonly("totalSyscalls", &SenderStatistics::totalSyscalls)
+        .def_readonly("totalSendErrors", &SenderStatistics::totalSendErrors)
+        .def_readonly("totalSendWouldBlock", &SenderStatistics::totalSendWouldBlock)
+        .def_readonly("totalNacksReceived", &SenderStatistics::totalNacksReceived)
+        .def_readonly("totalRetransmittedPackets", &SenderStatistics::totalRetransmittedPackets)
+        .def_readonly("totalSuppressedRetransmits",
+                      &SenderStatistics::totalSuppressedRetransmits)
+        .def_readonly("totalTilesSent", &SenderStatistics::totalTilesSent)
+        .def_readonly("totalTilesSkipped", &SenderStatistics::totalTilesSkipped)
+        .def_readonly("captureQueueDepth", &SenderStatistics::captureQueueDepth)
+        .def_readonly("encodeQueueDepth", &SenderStatistics::encodeQueueDepth)
+        .def_readonly("activeClients", &SenderStatistics::activeClients)
+        .def_readonly("windowFps", &SenderStatistics::windowFps)
+        .def_readonly("bitrateKbps", &SenderStatistics::bitrateKbps)
+        .def_readonly("lastFrameSize", &SenderStatistics::lastFrameSize)
+        .def_readonly("avgFrameSize", &SenderStatistics::avgFrameSize)
+        .def_readonly("avgPacketsPerFrame", &SenderStatistics::avgPacketsPerFrame)
+        .def_readonly("captureLatency", &SenderStatistics::captureLatency)
+        .def_readonly("encodeLatency", &SenderStatistics::encodeLatency)
+        .def_readonly("transmitLatency", &SenderStatistics::transmitLatency)
+        .def_readonly("captureToSendLatency", &SenderStatistics::captureToSendLatency);
 }
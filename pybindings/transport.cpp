@@ -0,0 +1,15 @@
+#include "transport.h"
+
+#include <pybind11/pybind11.h>
+
+namespace py = pybind11;
+using namespace MulticastLib;
+
+void init_io_backend(py::module_& m) {
+    py::enum_<IoBackend>(m, "IoBackend")
+        .value("Sockets", IoBackend::Sockets)
+        .value("IoUring", IoBackend::IoUring);
+
+    m.def("io_uring_supported", &ioUringSupported,
+          "Whether the io_uring backend is compiled in and accepted by the kernel");
+}